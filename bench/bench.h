@@ -0,0 +1,35 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+// Timing and reporting shared by the benchmarks in bench/. Every result is printed
+// as one JSON object per line, so 'make bench > results.json' can be kept and
+// compared across versions:
+//   {"bench":"tokenize.simple","iterations":200000,"ns_per_op":85,"tokens":4}
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+
+// Returns the current monotonic time in nanoseconds.
+static inline double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Prints the result of benchmark "<group>.<name>": 'iterations' runs that took
+// 'elapsed_ns' in all. 'extra_format' and the arguments after it add further
+// fields, each written as ',"key":value'; pass "" for none.
+static inline void bench_report(const char *group, const char *name, int iterations, double elapsed_ns,
+                                const char *extra_format, ...) {
+    printf("{\"bench\":\"%s.%s\",\"iterations\":%d,\"ns_per_op\":%.0f",
+           group, name, iterations, elapsed_ns / iterations);
+    va_list args;
+    va_start(args, extra_format);
+    vprintf(extra_format, args);
+    va_end(args);
+    printf("}\n");
+    fflush(stdout);
+}
+
+#endif // BENCH_H
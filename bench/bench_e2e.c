@@ -0,0 +1,203 @@
+// End-to-end benchmark: the shell as a user sees it. shell.out is started on a
+// pseudo-terminal, commands are typed into it, and the time from sending a line
+// to the next prompt appearing is measured, for:
+//   - simple commands ('true'),
+//   - pipelines of 2 to 16 stages,
+//   - background fan-out: N jobs started on one line, until all are reported done.
+// Latencies are given as mean, median and 99th percentile.
+//
+// The shell runs in a temporary directory (its history file goes there) with
+// $PROMPT set to a marker that command output never contains.
+//
+// Usage: bench_e2e [path/to/shell.out]   (default: ./shell.out)
+#define _GNU_SOURCE // For memmem()
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/wait.h>
+#include "bench.h"
+
+#define PROMPT_MARKER "<bench-prompt>"
+#define TIMEOUT_MS 10000
+
+static int g_master = -1;
+static pid_t g_shell = -1;
+// Output read from the shell that has not been matched yet.
+static char g_output[1 << 16];
+static size_t g_output_len = 0;
+
+static void fail(const char *what) {
+    fprintf(stderr, "bench_e2e: %s\n", what);
+    if (g_shell > 0) kill(g_shell, SIGKILL);
+    exit(1);
+}
+
+// Starts the shell on a new pseudo-terminal, as the leader of its own session.
+static void start_shell(const char *shell_path, const char *dir) {
+    g_master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (g_master < 0 || grantpt(g_master) < 0 || unlockpt(g_master) < 0) {
+        fail("cannot open a pseudo-terminal");
+    }
+    const char *slave_name = ptsname(g_master);
+    if (!slave_name) {
+        fail("ptsname failed");
+    }
+
+    g_shell = fork();
+    if (g_shell < 0) {
+        fail("fork failed");
+    }
+    if (g_shell == 0) {
+        setsid();
+        int slave = open(slave_name, O_RDWR); // Becomes the controlling terminal.
+        if (slave < 0 || chdir(dir) < 0) {
+            _exit(127);
+        }
+        dup2(slave, STDIN_FILENO);
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        close(slave);
+        close(g_master);
+        setenv("PROMPT", PROMPT_MARKER, 1);
+        unsetenv("MINI_SHELL_TIMING");
+        unsetenv("MINI_SHELL_TRACE");
+        execl(shell_path, shell_path, (char *)NULL);
+        _exit(127);
+    }
+}
+
+// Reads from the shell until 'count' occurrences of 'text' have arrived, and
+// drops the output up to the last of them.
+static void wait_for(const char *text, int count) {
+    size_t text_len = strlen(text);
+    int found = 0;
+    size_t scanned = 0;
+    double deadline = now_ns() + TIMEOUT_MS * 1e6;
+    while (true) {
+        char *match;
+        while ((match = memmem(g_output + scanned, g_output_len - scanned, text, text_len)) != NULL) {
+            scanned = match - g_output + text_len;
+            if (++found == count) {
+                memmove(g_output, g_output + scanned, g_output_len - scanned);
+                g_output_len -= scanned;
+                return;
+            }
+        }
+        // Keep only a possible partial match at the end, so the buffer never fills.
+        if (g_output_len - scanned >= text_len) {
+            scanned = g_output_len - (text_len - 1);
+        }
+        memmove(g_output, g_output + scanned, g_output_len - scanned);
+        g_output_len -= scanned;
+        scanned = 0;
+
+        int remaining_ms = (int)((deadline - now_ns()) / 1e6);
+        struct pollfd pfd = {.fd = g_master, .events = POLLIN};
+        if (remaining_ms <= 0 || poll(&pfd, 1, remaining_ms) <= 0) {
+            fail("timed out waiting for the shell");
+        }
+        ssize_t n = read(g_master, g_output + g_output_len, sizeof(g_output) - g_output_len);
+        if (n <= 0) {
+            fail("the shell exited");
+        }
+        g_output_len += n;
+    }
+}
+
+static void send_line(const char *line) {
+    size_t len = strlen(line);
+    if (write(g_master, line, len) != (ssize_t)len || write(g_master, "\n", 1) != 1) {
+        fail("write to the shell failed");
+    }
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Sends 'line' 'iterations' times. Each run ends when the shell has printed
+// 'done_text' 'done_count' times and then its prompt.
+static void run(const char *bench, const char *params, const char *line, int iterations,
+                const char *done_text, int done_count) {
+    double *samples = malloc(iterations * sizeof(double));
+    if (!samples) {
+        fail("out of memory");
+    }
+    double total = 0;
+    for (int i = 0; i < iterations; i++) {
+        double start = now_ns();
+        send_line(line);
+        if (done_text) {
+            wait_for(done_text, done_count);
+        }
+        wait_for(PROMPT_MARKER, 1);
+        samples[i] = now_ns() - start;
+        total += samples[i];
+    }
+    qsort(samples, iterations, sizeof(double), compare_doubles);
+    bench_report("e2e", bench, iterations, total, "%s,\"p50_ns\":%.0f,\"p99_ns\":%.0f",
+                 params, samples[iterations / 2], samples[(int)(iterations * 0.99)]);
+    free(samples);
+}
+
+int main(int argc, char *argv[]) {
+    char shell_path[PATH_MAX];
+    if (!realpath(argc > 1 ? argv[1] : "./shell.out", shell_path)) {
+        perror(argc > 1 ? argv[1] : "./shell.out");
+        return 1;
+    }
+    char dir[] = "/tmp/bench_e2e.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    start_shell(shell_path, dir);
+    wait_for(PROMPT_MARKER, 1);
+
+    char line[4096];
+    char params[64];
+
+    run("simple", "", "true", 500, NULL, 0);
+
+    const int stages[] = {2, 4, 8, 16};
+    for (size_t s = 0; s < sizeof(stages) / sizeof(stages[0]); s++) {
+        strcpy(line, "echo x");
+        for (int i = 1; i < stages[s]; i++) {
+            strcat(line, " | cat");
+        }
+        snprintf(params, sizeof(params), ",\"stages\":%d", stages[s]);
+        run("pipeline", params, line, 200, NULL, 0);
+    }
+
+    // Each job is reported with "exited normally" once the shell reaps it.
+    const int fan_out[] = {4, 16, 64};
+    for (size_t f = 0; f < sizeof(fan_out) / sizeof(fan_out[0]); f++) {
+        line[0] = '\0';
+        for (int i = 0; i < fan_out[f]; i++) {
+            strcat(line, "true & ");
+        }
+        snprintf(params, sizeof(params), ",\"jobs\":%d", fan_out[f]);
+        run("background_fan_out", params, line, 20, "exited normally", fan_out[f]);
+    }
+
+    // Ctrl-D ends the shell.
+    if (write(g_master, "\x04", 1) != 1) {
+        kill(g_shell, SIGKILL);
+    }
+    waitpid(g_shell, NULL, 0);
+    close(g_master);
+
+    char path[sizeof(dir) + 32];
+    snprintf(path, sizeof(path), "%s/.mini_shell_history", dir);
+    unlink(path);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,78 @@
+// Micro-benchmark: recording commands in history, as the shell does after every
+// line: add_to_history() alone, and add_to_history() + save_history(), which
+// appends the entry to the history file (compacting it now and then).
+//
+// Each is run with room for 15, 1000 and 100000 entries, so evicting the oldest
+// entry and compacting the file are part of the measurement. The history file is
+// written to a temporary directory that is removed afterwards.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "history.h"
+#include "bench.h"
+
+#define ADD_ITERATIONS 1000000
+#define SAVE_ITERATIONS 20000
+
+// Writes the i-th command into 'out'. Consecutive commands differ, since a repeat
+// of the newest entry is not added again.
+static void make_command(int i, char *out, size_t size) {
+    snprintf(out, size, "grep -rn pattern_%d src/module_%d/*.c | sort | head -%d", i, i % 37, i % 50);
+}
+
+static void run_add(int history_size) {
+    char command[128];
+    cleanup_history();
+    set_history_size(history_size);
+
+    double start = now_ns();
+    for (int i = 0; i < ADD_ITERATIONS; i++) {
+        make_command(i, command, sizeof(command));
+        add_to_history(command);
+    }
+    double elapsed = now_ns() - start;
+
+    bench_report("history", "add", ADD_ITERATIONS, elapsed, ",\"history_size\":%d", history_size);
+}
+
+static void run_add_and_save(const char *dir, int history_size) {
+    char command[128];
+    cleanup_history();
+    load_history(dir); // Sets the file path; the file does not exist yet.
+    set_history_size(history_size);
+
+    double start = now_ns();
+    for (int i = 0; i < SAVE_ITERATIONS; i++) {
+        make_command(i, command, sizeof(command));
+        add_to_history(command);
+        save_history();
+    }
+    double elapsed = now_ns() - start;
+    clear_history(); // Empties the file for the next run.
+
+    bench_report("history", "add_save", SAVE_ITERATIONS, elapsed, ",\"history_size\":%d", history_size);
+}
+
+int main(void) {
+    char dir[] = "/tmp/bench_history.XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    const int sizes[] = {15, 1000, 100000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run_add(sizes[i]);
+    }
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run_add_and_save(dir, sizes[i]);
+    }
+
+    cleanup_history();
+    char path[sizeof(dir) + 32];
+    snprintf(path, sizeof(path), "%s/.mini_shell_history", dir);
+    unlink(path);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,109 @@
+// Micro-benchmark: the background job table in src/jobs.c, with 10 to 100000
+// jobs in it: adding jobs, looking one up by id (as 'bg' does), listing them with
+// 'activities', reaping finished ones and tearing the table down.
+//
+// Most jobs are fake: their pids are above the kernel's pid limit, so no signal or
+// wait ever reaches a real process. Reaping is measured with real children that
+// have already exited, so it includes the waitpid() calls the shell makes.
+// Everything the job table prints goes to /dev/null.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "jobs.h"
+#include "job_control.h"
+#include "bench.h"
+
+// The shell's job control state lives in main.c, which is not part of libshell.a.
+// The benchmark runs without a terminal, as a script would.
+int g_terminal_fd = -1;
+pid_t g_shell_pgid;
+volatile pid_t g_foreground_pgid = 0;
+bool g_job_control = false;
+
+// Above the largest pid Linux hands out (2^22).
+#define FAKE_PID_BASE 5000000
+#define REAL_CHILDREN 200
+
+static int g_saved_stdout = -1;
+static int g_devnull = -1;
+
+// Sends the job table's messages to /dev/null while an operation is timed.
+static void silence_stdout(bool silent) {
+    fflush(stdout);
+    dup2(silent ? g_devnull : g_saved_stdout, STDOUT_FILENO);
+}
+
+static void report(const char *bench, int num_jobs, int iterations, double elapsed_ns) {
+    bench_report("jobs", bench, iterations, elapsed_ns, ",\"jobs\":%d", num_jobs);
+}
+
+static void run(int num_jobs) {
+    // Add: each job is a three-stage pipeline, as 'a | b | c &' would create.
+    silence_stdout(true);
+    double start = now_ns();
+    for (int i = 0; i < num_jobs; i++) {
+        pid_t pids[3] = {FAKE_PID_BASE + 3 * i, FAKE_PID_BASE + 3 * i + 1, FAKE_PID_BASE + 3 * i + 2};
+        add_job(pids[0], pids, 3, "sleep 100 | cat | wc -l");
+    }
+    double add_ns = now_ns() - start;
+
+    // Lookup: 'bg N' on a running job finds it by id and reports it is running.
+    int lookups = 10000;
+    start = now_ns();
+    for (int i = 0; i < lookups; i++) {
+        continue_job_in_background(1 + (int)((unsigned)i * 2654435761u % num_jobs), false);
+    }
+    double lookup_ns = now_ns() - start;
+
+    // Activities: reaps, sorts by command and prints every job.
+    int listings = num_jobs >= 10000 ? 5 : 200;
+    start = now_ns();
+    for (int i = 0; i < listings; i++) {
+        list_activities();
+    }
+    double list_ns = now_ns() - start;
+
+    // Reap: real children that have already exited, among all the fake jobs.
+    pid_t children[REAL_CHILDREN];
+    for (int i = 0; i < REAL_CHILDREN; i++) {
+        children[i] = fork();
+        if (children[i] == 0) {
+            _exit(0);
+        }
+        add_job(children[i], &children[i], 1, "true");
+    }
+    struct timespec settle = {0, 200000000};
+    nanosleep(&settle, NULL); // Let them all exit.
+    start = now_ns();
+    check_background_jobs();
+    double reap_ns = now_ns() - start;
+
+    // Remove: tear down the whole table.
+    start = now_ns();
+    cleanup_jobs();
+    double remove_ns = now_ns() - start;
+    silence_stdout(false);
+
+    report("add", num_jobs, num_jobs, add_ns);
+    report("lookup", num_jobs, lookups, lookup_ns);
+    report("activities", num_jobs, listings, list_ns);
+    report("reap", num_jobs, REAL_CHILDREN, reap_ns);
+    report("remove", num_jobs, num_jobs, remove_ns);
+}
+
+int main(void) {
+    g_saved_stdout = dup(STDOUT_FILENO);
+    g_devnull = open("/dev/null", O_WRONLY);
+    if (g_saved_stdout < 0 || g_devnull < 0) {
+        perror("bench_jobs");
+        return 1;
+    }
+    const int sizes[] = {10, 1000, 100000};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        run(sizes[i]);
+    }
+    return 0;
+}
@@ -0,0 +1,86 @@
+// Micro-benchmark: tokenize() + parse_command() on typical interactive lines, and
+// the plan cache that lets a repeated line skip both.
+//
+// Each line is compiled into a fresh plan many times; the plan arena is reset in
+// between so only parsing is measured, not the allocator growing. The time given
+// for parse_command() excludes the tokenize() that precedes it.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tokenizer.h"
+#include "parser.h"
+#include "plan_cache.h"
+#include "arena.h"
+#include "bench.h"
+
+#define ITERATIONS 200000
+
+static const struct {
+    const char *name;
+    const char *line;
+} LINES[] = {
+    {"simple", "ls -l /usr/share/doc"},
+    {"redirects", "sort -u < input.txt > output.txt"},
+    {"pipeline", "cat access.log | grep GET | cut -d' ' -f1 | sort | uniq -c | sort -rn | head"},
+    {"and_or", "make -j8 && ./run_tests --fast || echo failed ; echo done &"},
+    {"loop", "for f in a.c b.c c.c d.c; do gcc -c $f -o $f.o && echo $f; done"},
+};
+
+// Measures tokenize() alone, then tokenize() followed by parse_command().
+static void run_parse(const char *name, const char *line) {
+    Arena token_arena = {NULL, 0, 0, 0, 0};
+    ExecutionPlan plan;
+    memset(&plan, 0, sizeof(plan));
+    int token_count = 0;
+
+    double start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        tokenize(&token_arena, line, &token_count);
+        arena_reset(&token_arena);
+    }
+    double tokenize_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        Token *tokens = tokenize(&token_arena, line, &token_count);
+        if (parse_command(tokens, token_count, &plan) != PARSE_OK) {
+            fprintf(stderr, "bench_parser: '%s' does not parse\n", line);
+            exit(1);
+        }
+        arena_reset(&plan.arena);
+        arena_reset(&token_arena);
+    }
+    double parse_ns = now_ns() - start - tokenize_ns;
+    arena_destroy(&plan.arena);
+    arena_destroy(&token_arena);
+
+    bench_report("tokenize", name, ITERATIONS, tokenize_ns, ",\"tokens\":%d", token_count);
+    bench_report("parse_command", name, ITERATIONS, parse_ns, ",\"tokens\":%d", token_count);
+}
+
+// Measures a plan cache hit, which is what re-running a line costs.
+static void run_cache_hit(const char *name, const char *line) {
+    ParseResult result;
+    plan_cache_release(plan_cache_acquire(line, &result)); // Compile it once.
+
+    double start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        plan_cache_release(plan_cache_acquire(line, &result));
+    }
+    double elapsed = now_ns() - start;
+    line_arena_finish();
+
+    bench_report("plan_cache.hit", name, ITERATIONS, elapsed, "");
+}
+
+int main(void) {
+    for (size_t i = 0; i < sizeof(LINES) / sizeof(LINES[0]); i++) {
+        run_parse(LINES[i].name, LINES[i].line);
+    }
+    for (size_t i = 0; i < sizeof(LINES) / sizeof(LINES[0]); i++) {
+        run_cache_hit(LINES[i].name, LINES[i].line);
+    }
+    cleanup_plan_cache();
+    cleanup_line_arena();
+    return 0;
+}
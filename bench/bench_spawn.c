@@ -0,0 +1,68 @@
+// Micro-benchmark: launch latency of fork()+execvp() versus posix_spawnp().
+//
+// The shell launches every external command one way or the other, and the cost of
+// fork() grows with the size of the parent's address space. To show that, each path
+// is measured twice: once from a small process and once after mapping and touching
+// a "ballast" region that stands in for a shell with large history/job tables.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include "bench.h"
+
+extern char **environ;
+
+#define ITERATIONS 500
+#define BALLAST_BYTES (256UL * 1024 * 1024)
+
+// Kept in a volatile global so the compiler cannot drop the ballast allocation.
+static char *volatile g_ballast = NULL;
+
+static void launch_fork(char **argv) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+}
+
+static void launch_spawn(char **argv) {
+    pid_t pid;
+    if (posix_spawnp(&pid, argv[0], NULL, NULL, argv, environ) == 0) {
+        int status;
+        waitpid(pid, &status, 0);
+    }
+}
+
+static void run(const char *name, void (*launch)(char **), char **argv, size_t ballast) {
+    double start = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        launch(argv);
+    }
+    bench_report("spawn", name, ITERATIONS, now_ns() - start, ",\"ballast_bytes\":%zu", ballast);
+}
+
+int main(void) {
+    char *argv[] = {"true", NULL};
+
+    run("fork_exec", launch_fork, argv, 0);
+    run("posix_spawn", launch_spawn, argv, 0);
+
+    // Touch every page so it is really mapped and fork() has to copy its page tables.
+    g_ballast = malloc(BALLAST_BYTES);
+    if (!g_ballast) {
+        perror("malloc");
+        return 1;
+    }
+    memset(g_ballast, 1, BALLAST_BYTES);
+
+    run("fork_exec", launch_fork, argv, BALLAST_BYTES);
+    run("posix_spawn", launch_spawn, argv, BALLAST_BYTES);
+
+    free(g_ballast);
+    return 0;
+}
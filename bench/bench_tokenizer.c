@@ -0,0 +1,61 @@
+// Micro-benchmark: tokenize() over long synthetic command lines, once per
+// delimiter scanner (scalar lookup table, SSE2, AVX2).
+//
+// The lines imitate generated xargs-style invocations: a command followed by
+// thousands of path-like arguments, with an occasional pipe or redirection.
+// Throughput is reported in MB/s of input alongside the time per line.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tokenizer.h"
+#include "arena.h"
+#include "bench.h"
+
+// Builds a line of roughly 'size' bytes.
+static char* make_line(size_t size) {
+    char *line = malloc(size + 64);
+    size_t len = 0;
+    len += sprintf(line, "process_files");
+    for (int i = 0; len < size; i++) {
+        if (i % 997 == 996) {
+            len += sprintf(line + len, " | filter_stage");
+        } else {
+            len += sprintf(line + len, " ./data/set_%04d/input_file_%06d.txt", i % 100, i);
+        }
+    }
+    len += sprintf(line + len, " > results.txt");
+    return line;
+}
+
+static void run(const char *name, ScanMode mode, const char *line, size_t size, int iterations) {
+    if (!tokenizer_set_scan_mode(mode)) {
+        return; // Not supported on this CPU.
+    }
+    Arena arena = {NULL, 0, 0, 0, 0};
+    int token_count = 0;
+
+    double start = now_ns();
+    for (int i = 0; i < iterations; i++) {
+        tokenize(&arena, line, &token_count);
+        arena_reset(&arena);
+    }
+    double elapsed = now_ns() - start;
+    arena_destroy(&arena);
+
+    bench_report("tokenize", name, iterations, elapsed, ",\"line_bytes\":%zu,\"tokens\":%d,\"mb_per_s\":%.1f",
+                 size, token_count, (double)size * iterations / (elapsed / 1e9) / 1e6);
+}
+
+int main(void) {
+    const size_t sizes[] = {4 * 1024, 256 * 1024};
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *line = make_line(sizes[i]);
+        size_t size = strlen(line);
+        int iterations = (int)(64 * 1024 * 1024 / size);
+        run("scalar", SCAN_SCALAR, line, size, iterations);
+        run("sse2", SCAN_SSE2, line, size, iterations);
+        run("avx2", SCAN_AVX2, line, size, iterations);
+        free(line);
+    }
+    return 0;
+}
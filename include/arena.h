@@ -0,0 +1,72 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h> // For size_t
+
+// A bump allocator. Allocations are carved out of large blocks and are never freed
+// individually; the whole arena is released at once with arena_reset().
+
+typedef struct ArenaBlock ArenaBlock;
+
+typedef struct {
+    ArenaBlock *blocks;    // Most recently added block first
+    size_t bytes;          // Bytes handed out since the last reset
+    size_t allocations;    // Allocations made since the last reset
+    size_t block_size;     // Size of the first block, or 0 for the default (16 KiB)
+    size_t recent_bytes;   // Recent peak of 'bytes' at reset, halving at every reset
+} Arena;
+
+// A position in an arena, for releasing everything allocated after it.
+typedef struct {
+    ArenaBlock *block;     // The newest block when the mark was taken
+    size_t used;           // Bytes used in that block
+    size_t bytes;
+    size_t allocations;
+} ArenaMark;
+
+// Usage statistics for one command line.
+typedef struct {
+    size_t bytes;          // Bytes allocated while processing the line
+    size_t allocations;    // Number of allocations made while processing the line
+    size_t reserved;       // Bytes reserved from the system for the arena's blocks
+} ArenaStats;
+
+// Called with the statistics of every command line when it finishes.
+typedef void (*ArenaStatsHook)(const ArenaStats *stats);
+
+// The arena for everything allocated while parsing and executing one command line.
+// It is reset by line_arena_finish() once the line has been fully processed.
+extern Arena g_line_arena;
+
+// Allocates 'size' bytes, suitably aligned for any type. Exits on out-of-memory.
+void* arena_alloc(Arena *arena, size_t size);
+
+// Copies a string into the arena.
+char* arena_strdup(Arena *arena, const char *str);
+
+// Returns the arena's current position.
+ArenaMark arena_mark(const Arena *arena);
+
+// Releases every allocation made since 'mark' was taken, so a loop can reuse the
+// same memory on every iteration.
+void arena_release_to(Arena *arena, ArenaMark mark);
+
+// Releases every allocation. Memory is kept in one block sized for the next use;
+// a block grown for one unusually large line is given back once lines are small
+// again.
+void arena_reset(Arena *arena);
+
+// Frees all memory owned by the arena.
+void arena_destroy(Arena *arena);
+
+// Finishes the current command line: reports its statistics to the stats hook,
+// if one is set, and then resets the line arena.
+void line_arena_finish(void);
+
+// Installs a hook that receives per-line statistics. Pass NULL to remove it.
+void line_arena_set_stats_hook(ArenaStatsHook hook);
+
+// Frees all memory owned by the line arena.
+void cleanup_line_arena(void);
+
+#endif // ARENA_H
@@ -3,39 +3,65 @@
 
 #include "tokenizer.h"
 
+// Every handler returns the builtin's exit status: 0 on success, non-zero on failure.
+
 // Handles the 'hop' shell builtin command.
 // tokens: The array of tokens from the user's input.
 // token_count: The number of tokens in the array.
 // home_dir: The directory where the shell was started.
-void handle_hop(Token *tokens, int token_count, const char *home_dir);
+int handle_hop(Token *tokens, int token_count, const char *home_dir);
 
 // Handles the 'reveal' shell builtin command.
 // tokens: The array of tokens from the user's input.
 // token_count: The number of tokens in the array.
 // home_dir: The directory where the shell was started.
-void handle_reveal(Token *tokens, int token_count, const char *home_dir);
+int handle_reveal(Token *tokens, int token_count, const char *home_dir);
 
 // Handles the 'log' shell builtin command.
 // tokens: The array of tokens from the user's input.
 // token_count: The number of tokens in the array.
-void handle_log(Token *tokens, int token_count);
+int handle_log(Token *tokens, int token_count);
 
 // Handles the 'activities' shell builtin command by listing active jobs.
-void handle_activities(void);
+int handle_activities(void);
 
 // Handles the 'ping' shell builtin command to send a signal to a process.
 // tokens: The array of tokens from the user's input.
 // token_count: The number of tokens in the array.
-void handle_ping(Token *tokens, int token_count);
+int handle_ping(Token *tokens, int token_count);
 
 // Handles the 'fg' shell builtin command to bring a job to the foreground.
 // tokens: The array of tokens from the user's input.
 // token_count: The number of tokens in the array.
-void handle_fg(Token *tokens, int token_count);
+int handle_fg(Token *tokens, int token_count);
 
 // Handles the 'bg' shell builtin command to resume a stopped job.
 // tokens: The array of tokens from the user's input.
 // token_count: The number of tokens in the array.
-void handle_bg(Token *tokens, int token_count);
+int handle_bg(Token *tokens, int token_count);
+
+// Handles the 'jobs' shell builtin command for background job slots.
+// 'jobs' lists jobs and queued commands, 'jobs -j' shows the limit on running
+// background jobs and 'jobs -j N' sets it (0 means unlimited).
+// tokens: The array of tokens from the user's input.
+// token_count: The number of tokens in the array.
+int handle_jobs(Token *tokens, int token_count);
+
+// Handles the 'hash' shell builtin command for the command path cache.
+// 'hash' lists the table, 'hash -r' clears it and 'hash name...' resolves names into it.
+// tokens: The array of tokens from the user's input.
+// token_count: The number of tokens in the array.
+int handle_hash(Token *tokens, int token_count);
+
+// Handles the 'export' shell builtin command.
+// 'export' lists the environment and 'export NAME[=value]...' adds variables to it.
+// tokens: The array of tokens from the user's input.
+// token_count: The number of tokens in the array.
+int handle_export(Token *tokens, int token_count);
+
+// Handles the 'unset' shell builtin command, which removes variables.
+// tokens: The array of tokens from the user's input.
+// token_count: The number of tokens in the array.
+int handle_unset(Token *tokens, int token_count);
 
 #endif // BUILTINS_H
\ No newline at end of file
@@ -0,0 +1,24 @@
+#ifndef COMMAND_HASH_H
+#define COMMAND_HASH_H
+
+// Resolves a command name to the path of an executable, like bash's command hash.
+// Results are memoized so repeated commands skip the $PATH walk entirely.
+// Names containing a '/' are returned unchanged.
+// The table is flushed automatically whenever $PATH changes.
+// Returns NULL if the command cannot be found. The returned string is owned by the
+// hash table and is only valid until the next call into this module.
+const char* hash_lookup_command(const char *name);
+
+// Removes a single command from the table, e.g. after exec'ing its cached path fails.
+void hash_forget_command(const char *name);
+
+// Removes every command from the table ('hash -r').
+void hash_clear(void);
+
+// Prints the table in the format "hits<TAB>path", one command per line.
+void hash_print(void);
+
+// Frees all memory used by the table.
+void cleanup_command_hash(void);
+
+#endif // COMMAND_HASH_H
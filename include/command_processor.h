@@ -3,7 +3,26 @@
 
 #include <stdbool.h>
 
+#include <stddef.h>
+
 // The main entry point for processing a line of user input.
-void process_command_line(const char *command, const char *home_dir, bool should_log);
+// Returns false, without running or logging anything, if the line ends inside a
+// loop; the caller then joins the following lines onto it with append_command_line()
+// and tries again.
+bool process_command_line(const char *command, const char *home_dir, bool should_log);
+
+// Runs a background command taken from the job slot queue. It may start between
+// any two commands, so '$?' and an interrupted list are left as they were.
+void run_queued_command_line(const char *command, const char *home_dir);
+
+// Appends one more input line to a command being collected in the malloc'd '*buffer'
+// of length '*len'. Blank lines are skipped.
+void append_command_line(char **buffer, size_t *len, const char *line);
+
+// Reports a command still unfinished at the end of input as a syntax error.
+void reject_incomplete_command(void);
+
+// Returns the exit status of the most recent command, as '$?' expands to.
+int get_last_status(void);
 
 #endif // COMMAND_PROCESSOR_H
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define EXTERNAL_H
 
 #include <stdbool.h>
+#include <sys/types.h> // For pid_t
 #include "tokenizer.h"
 
 // Handles external commands that are not built-in shell commands.
@@ -9,7 +10,28 @@
 // token_count: The number of tokens in the array.
 // home_dir: The directory where the shell was started.
 // is_background: True if the command should run in the background.
-// full_command: The full command string for job control messages. Can be NULL if not applicable.
-void handle_external_command(Token *tokens, int token_count, const char *home_dir, bool is_background, const char *full_command);
+// full_command: The full command string for job control messages.
+// Returns the command's exit status (0 once a background command has started).
+int handle_external_command(Token *tokens, int token_count, const char *home_dir, bool is_background, const char *full_command);
+
+// Launches one stage of a pipeline as exactly one child process: the stage's own
+// redirections are applied and the program is exec'd directly. External programs are
+// started with posix_spawn; only child-safe built-ins ('reveal', 'log', 'export') are forked.
+// Does not wait for the child.
+// tokens: The stage's tokens, terminated by an EOL token.
+// token_count: The number of tokens in the stage.
+// home_dir: The directory where the shell was started.
+// pgid: The process group to join, or 0 to start a new group led by this stage.
+// in_fd: The fd to use as the stage's stdin, or -1 to inherit. Must be close-on-exec.
+// out_fd: The fd to use as the stage's stdout, or -1 to inherit. Must be close-on-exec.
+// is_background: True if stdin should come from /dev/null when not otherwise set.
+// name: If not NULL, receives the command's name (its argv[0], past any
+//       redirections and assignments), or NULL if the stage has no command.
+// Returns the PID of the stage, or -1 if it could not be started.
+pid_t launch_pipeline_stage(Token *tokens, int token_count, const char *home_dir, pid_t pgid, int in_fd, int out_fd, bool is_background, const char **name);
+
+// Returns the exit status that stands for the most recent failed launch: 127 if the
+// command was not found, 126 if it could not be executed, 1 for a redirection error.
+int launch_failure_status(void);
 
 #endif // EXTERNAL_H
\ No newline at end of file
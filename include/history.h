@@ -2,11 +2,13 @@
 #define HISTORY_H
 
 #include <stdbool.h>
+#include "usage.h"
 
 // Loads command history from the history file.
 void load_history(const char *home_dir);
 
-// Saves command history to the history file.
+// Appends the commands added since the last save to the history file.
+// The file is an append-only journal that is compacted once it grows too large.
 void save_history(void);
 
 // Adds a command to the history list.
@@ -15,13 +17,42 @@ void add_to_history(const char *command);
 // Prints all commands in the history.
 void print_history(void);
 
+// Prints every command in history that contains 'pattern' (or starts with it, if
+// 'prefix_only' is set), oldest first, each preceded by its 'log execute' index.
+// Lookups go through a trigram index, so they do not scan the whole history.
+void search_history(const char *pattern, bool prefix_only);
+
+// Prints every command in history, oldest first, with the resources it used when
+// it last ran, if they were measured.
+void print_history_usage(void);
+
+// Returns an id for the newest history entry, or -1 if history is empty. Usage
+// measured later is attached to the entry through this id.
+long get_history_entry_id(void);
+
+// Adds 'usage' to what is recorded for the entry 'entry_id', if it is still in
+// history.
+void add_history_usage(long entry_id, const ResourceUsage *usage);
+
 // Clears all commands from history (in memory and on disk).
 void clear_history(void);
 
 // Retrieves a command from history by its 1-based, newest-to-oldest index.
+// The returned string is only valid until the history is next modified.
 const char* get_history_command(int index);
 
 // Gets the current number of commands in history.
 int get_history_count(void);
 
+// Gets the maximum number of commands kept in history.
+// Defaults to 15, or $MINI_SHELL_HISTSIZE when it is set.
+int get_history_size(void);
+
+// Changes the maximum number of commands kept in history, dropping the oldest
+// entries if there are more than 'size'. Returns false if 'size' is out of range.
+bool set_history_size(int size);
+
+// Frees all memory used by the in-memory history.
+void cleanup_history(void);
+
 #endif // HISTORY_H
\ No newline at end of file
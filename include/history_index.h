@@ -0,0 +1,26 @@
+#ifndef HISTORY_INDEX_H
+#define HISTORY_INDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A trigram index over history entries, used by 'log search'.
+// Every entry is identified by a sequence number that increases by one for each
+// entry ever added. For every 3-byte substring of an entry, the index keeps the
+// ascending list of sequence numbers of the entries that contain it.
+
+// Indexes a newly added entry. 'oldest_seq' is the sequence number of the oldest
+// entry still in history; postings for older entries are dropped lazily.
+void history_index_add(uint32_t seq, const char *entry, uint32_t oldest_seq);
+
+// Returns the ascending list of sequence numbers of entries that may contain
+// 'pattern' and stores its length in 'count'. Candidates must still be verified,
+// and may include entries that were evicted from history since.
+// Returns NULL with *count == 0 if no entry can match, or NULL with *count == (size_t)-1
+// if 'pattern' is too short to be looked up (fewer than 3 bytes).
+const uint32_t* history_index_lookup(const char *pattern, size_t *count);
+
+// Removes every entry from the index.
+void history_index_clear(void);
+
+#endif // HISTORY_INDEX_H
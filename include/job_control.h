@@ -2,6 +2,7 @@
 #define JOB_CONTROL_H
 
 #include <sys/types.h>
+#include <stdbool.h>
 
 // The file descriptor for the terminal, which the shell is running on.
 extern int g_terminal_fd;
@@ -10,5 +11,8 @@ extern pid_t g_shell_pgid;
 // The PGID of the current foreground job. 0 if no foreground job.
 // 'volatile' is important because this can be changed by a signal handler.
 extern volatile pid_t g_foreground_pgid;
+// True in the interactive loop. Scripts run without job control: their commands are
+// not moved into process groups of their own.
+extern bool g_job_control;
 
 #endif // JOB_CONTROL_H
\ No newline at end of file
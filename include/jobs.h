@@ -10,16 +10,28 @@ typedef enum {
     JOB_STOPPED
 } JobState;
 
-// Initializes the job control system.
+// Initializes the job control system and installs the SIGCHLD handler.
 void init_jobs(void);
 
+// Returns a file descriptor that becomes readable whenever a child process changes
+// state (SIGCHLD), for use with poll(). Returns -1 if it is unavailable.
+int jobs_event_fd(void);
+
+// Handles pending child state changes: if SIGCHLD fired since the last call, reaps
+// and reports finished background jobs. Cheap when nothing happened.
+// at_prompt: True if a prompt is on screen, so reports start on a new line.
+// Returns true if any report was printed.
+bool process_job_events(bool at_prompt);
+
 // Cleans up any resources used by the job control system.
 void cleanup_jobs(void);
 
-// Adds a new background job to the tracking list.
-// pid: The process ID of the background job to track.
+// Adds a new background job to the tracking list. The job finishes once every
+// one of its processes has exited, and its status is that of the last process.
+// pgid: The process group of the job, reported as its pid.
+// pids: The job's processes in pipeline order (one for a simple command).
 // full_command: The full command string that was executed.
-void add_job(pid_t pid, const char *full_command);
+void add_job(pid_t pgid, const pid_t *pids, int num_pids, const char *full_command);
 
 // Checks for any completed background jobs and prints their status.
 // This function is non-blocking and reaps any finished child process.
@@ -29,17 +41,48 @@ void check_background_jobs(void);
 void list_activities(void);
 
 // Adds a new job that was stopped (e.g., by Ctrl+Z) to the tracking list.
-void add_job_stopped(pid_t pid, const char *full_command);
+// statuses: The waitpid() status of each process; processes that had already
+// exited when the job stopped are recorded as finished.
+void add_job_stopped(pid_t pgid, const pid_t *pids, const int *statuses, int num_pids,
+                     const char *full_command);
+
+// --- Job Slots ---
+// The number of background jobs running at once can be capped. Background commands
+// started while every slot is busy are queued and run as earlier jobs finish.
+
+// Returns true if another background job may start now.
+bool job_slot_available(void);
+
+// Gets or sets the maximum number of running background jobs; 0 means no limit.
+int get_max_running_jobs(void);
+void set_max_running_jobs(int limit);
+
+// Registers the function that starts a queued command line once a slot frees up.
+void set_queued_job_launcher(void (*launcher)(const char *command, void *context), void *context);
+
+// Queues a background command line (including its trailing '&') for later.
+void queue_background_command(const char *command);
+
+// Prints the queued command lines, oldest first.
+void list_queued_jobs(void);
+
+// Blocks until every queued command has been started. Used before a script exits.
+void wait_for_queued_jobs(void);
 
 // Sends SIGKILL to all tracked background jobs.
 // This is used to clean up before the shell exits.
 void kill_all_jobs(void);
 
 // Continues a job in the foreground.
-void continue_job_in_foreground(int job_id, bool use_default_job);
+// Returns the job's exit status, or 1 if there is no such job.
+int continue_job_in_foreground(int job_id, bool use_default_job);
+
+// Continues a stopped job in the background. Returns 0, or 1 on failure.
+int continue_job_in_background(int job_id, bool use_default_job);
 
-// Continues a stopped job in the background.
-void continue_job_in_background(int job_id, bool use_default_job);
+// Converts a waitpid() status to a shell exit status: the exit code, or 128 plus
+// the number of the signal that killed or stopped the process.
+int exit_status_from_wait(int status);
 
 
 #endif // JOBS_H
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <stddef.h> // For size_t
+#include <stdbool.h>
+
+// An fd watched while the reader waits for input, added with line_reader_add_event().
+typedef struct {
+    int fd;
+    void (*on_event)(void *context);
+    void *context;
+} LineReaderEvent;
+
+#define LINE_READER_MAX_EVENTS 4
+
+// A buffered reader that hands out complete lines of any length.
+// Input is read with read(2) in large chunks into one growable buffer, and lines
+// are returned in place (the newline is replaced by a NUL), so no per-line copy
+// is made. A line ending in a backslash is joined with the line that follows it.
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t start;                     // First byte not yet returned
+    size_t end;                       // End of the data read so far
+    bool eof;
+    const char *continuation_prompt;  // Printed before reading a continued line, or NULL
+    bool continuing;                  // Set while the line being read was ended by a backslash
+    // Other inputs to watch while waiting for data: whenever one of them is
+    // readable, its callback is called before waiting again.
+    LineReaderEvent events[LINE_READER_MAX_EVENTS];
+    int num_events;
+} LineReader;
+
+// Prepares a reader for 'fd'. The reader does not take ownership of the fd.
+void line_reader_init(LineReader *reader, int fd);
+
+// Calls 'on_event' whenever 'fd' becomes readable while the reader is waiting for
+// input. The callback must drain the fd. Returns false if too many are registered.
+bool line_reader_add_event(LineReader *reader, int fd, void (*on_event)(void *context), void *context);
+
+// Frees the reader's buffer.
+void line_reader_free(LineReader *reader);
+
+// Moves the input 'source' has read but not returned yet into 'reader', a newly
+// initialized reader for the same fd, which then returns it first. The lines
+// 'source' returned earlier stay valid.
+void line_reader_take_buffered(LineReader *reader, LineReader *source);
+
+// Returns the next line without its trailing newline, or NULL at end of input.
+// 'length', if not NULL, receives the length of the line.
+// The line stays valid until the next call on the same reader.
+char* line_reader_next(LineReader *reader, size_t *length);
+
+#endif // LINE_READER_H
@@ -0,0 +1,23 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "tokenizer.h"
+#include "line_reader.h"
+
+// Handles the 'parallel' shell builtin command:
+//   parallel [N] cmd [args...] ::: input...
+//   parallel [N] cmd [args...]            (inputs are the lines of stdin)
+// Runs the command once per input with "{}" replaced by the input (or the input
+// appended if there is no "{}"), keeping up to N jobs running (default: one per CPU).
+// Each job's stdout is buffered and printed in input order, and the number of
+// failed jobs is reported at the end. Returns 1 if any job failed, 0 otherwise.
+// tokens: The array of tokens from the user's input.
+// token_count: The number of tokens in the array.
+// home_dir: The directory where the shell was started.
+int handle_parallel(Token *tokens, int token_count, const char *home_dir);
+
+// Tells 'parallel' which reader the shell reads its commands from stdin with, so
+// inputs read from stdin start with what that reader has already buffered.
+void set_parallel_stdin_reader(LineReader *reader);
+
+#endif // PARALLEL_H
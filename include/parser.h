@@ -2,11 +2,92 @@
 #define PARSER_H
 
 #include "tokenizer.h"
+#include "arena.h"
 #include <stdbool.h> // For the bool type
 
-// The main entry point for the parser.
-// Takes a list of tokens and its size.
-// Returns true if the command syntax is valid, false otherwise.
-bool parse_command(Token *tokens, int token_count);
+// --- Execution Plan ---
+// The parser compiles a command line into a tree that mirrors the grammar:
+//
+//   list     -> and_or ((; | &) and_or)* &?
+//   and_or   -> pipeline ((&& | ||) pipeline)*
+//   pipeline -> time? (command (| command)* | loop)
+//   command  -> name (name | < name | > name | >> name)*
+//   loop     -> for name in name* ; do list done
+//             | while list do list done
+//
+// Every node and string lives in the plan's arena, so a plan can be executed any
+// number of times after the tokens it came from are gone. Inside a loop, a list
+// may end with ';' or '&' before 'do' or 'done', and 'do' may be followed by ';',
+// so a loop written over several lines can be joined with "; ".
 
-#endif // PARSER_H
\ No newline at end of file
+typedef struct PlanList PlanList;
+typedef struct PlanLoop PlanLoop;
+
+// One redirection of a simple command.
+typedef struct {
+    TokenType type;      // TOKEN_REDIRECT_IN, TOKEN_REDIRECT_OUT or TOKEN_REDIRECT_APPEND
+    const char *target;  // The file name
+} PlanRedirect;
+
+// A simple command: a program or builtin with its arguments and redirections.
+typedef struct {
+    Token *tokens;            // All of the command's tokens, terminated by EOL
+    int token_count;          // Including the EOL token
+    Token *words;             // Just the words (the argv), terminated by EOL
+    int word_count;           // Including the EOL token
+    PlanRedirect *redirects;  // In the order they appear
+    int num_redirects;
+} PlanCommand;
+
+// Commands joined by '|', or a loop.
+typedef struct {
+    PlanCommand *commands;
+    int num_commands;
+    PlanLoop *loop;           // Set instead of 'commands' for a 'for' or 'while' loop
+    bool timed;               // Prefixed with 'time': report what it used when done
+    const char *text;         // The pipeline as text, for job control messages
+} PlanPipeline;
+
+// Pipelines joined by '&&' and '||'.
+typedef struct {
+    PlanPipeline *pipelines;
+    TokenType *operators;     // operators[i] joins pipelines[i] and pipelines[i + 1]
+    int num_pipelines;
+    bool is_background;       // Followed by '&'
+    const char *text;         // The whole list as text, for job control messages
+} PlanAndOr;
+
+// And-or lists run one after another.
+struct PlanList {
+    PlanAndOr *entries;
+    int num_entries;
+};
+
+// A 'for' or 'while' loop. The body is compiled once and run on every iteration.
+struct PlanLoop {
+    bool is_for;
+    const char *variable;     // 'for': the loop variable
+    Token *items;             // 'for': the words to iterate over, terminated by EOL
+    int num_items;
+    PlanList condition;       // 'while': runs before every iteration, looping while it succeeds
+    PlanList body;
+};
+
+// A compiled command line.
+typedef struct {
+    PlanList list;
+    bool runs_log;            // Some command is 'log', so the line is not added to history
+    Arena arena;              // Owns every node and string of the plan
+} ExecutionPlan;
+
+// The outcome of compiling a command line.
+typedef enum {
+    PARSE_OK,          // The plan is complete
+    PARSE_INVALID,     // The command syntax is invalid
+    PARSE_INCOMPLETE   // The line ends inside a loop; more lines are needed
+} ParseResult;
+
+// Compiles a tokenized command line into 'plan', allocating from plan->arena.
+ParseResult parse_command(Token *tokens, int token_count, ExecutionPlan *plan);
+
+#endif // PARSER_H
@@ -11,6 +11,7 @@
 // home_dir: The home directory for context.
 // is_background: True if the entire pipeline should run in the background.
 // full_command: The full command string for job control messages.
-void execute_pipeline(Token **segments, int *segment_counts, int num_segments, const char *home_dir, bool is_background, const char *full_command);
+// Returns the exit status of the last command (0 once a background job has started).
+int execute_pipeline(Token **segments, int *segment_counts, int num_segments, const char *home_dir, bool is_background, const char *full_command);
 
 #endif // PIPELINE_H
\ No newline at end of file
@@ -0,0 +1,20 @@
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include "parser.h"
+
+// Returns the compiled execution plan for a command line, tokenizing and parsing it
+// only the first time the exact same text is seen. Recently used plans are kept,
+// so re-running a line (e.g. with 'log execute' or in a loop) skips parsing entirely.
+// Returns NULL if the line does not compile, with the reason in 'result'. Every
+// plan returned must be handed back with plan_cache_release(); until then it stays
+// valid even if it is evicted.
+ExecutionPlan* plan_cache_acquire(const char *line, ParseResult *result);
+
+// Releases a plan returned by plan_cache_acquire().
+void plan_cache_release(ExecutionPlan *plan);
+
+// Frees all memory used by the cache.
+void cleanup_plan_cache(void);
+
+#endif // PLAN_CACHE_H
@@ -1,6 +1,27 @@
 #ifndef PROMPT_H
 #define PROMPT_H
 
-void display_prompt(char* home_dir);
+// Looks up everything the prompt shows that does not change while the shell runs
+// (user name, host name) and the starting directory. Call once before display_prompt().
+void init_prompt(const char *home_dir);
 
-#endif // PROMPT_H
\ No newline at end of file
+// Records the shell's new working directory. 'hop' calls this after every
+// successful chdir, so the prompt never has to ask the system for it.
+void prompt_set_cwd(const char *cwd);
+
+// Prints the prompt. It is formatted from $PROMPT, where \u is the user, \h the
+// host up to the first '.', \H the full host, \w the directory (with the home
+// directory shown as '~'), \W its last part, \n a newline, \\ a backslash and
+// \{name} a prompt segment (see prompt_segments.h); the default is "<\u@\H:\w> ".
+// The formatted prompt is cached and only rebuilt when the directory, $PROMPT or
+// a segment changes.
+void display_prompt(void);
+
+// Called when the prompt segment worker signals new values: the prompt on screen
+// is redrawn in place if it changed and has only just been shown.
+void prompt_segments_updated(void);
+
+// Frees the memory used by the cached prompt.
+void cleanup_prompt(void);
+
+#endif // PROMPT_H
@@ -0,0 +1,59 @@
+#ifndef PROMPT_SEGMENTS_H
+#define PROMPT_SEGMENTS_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Prompt segments are named pieces of the prompt, shown with "\{name}" in $PROMPT,
+// e.g. PROMPT=\{git}\w$. Cheap segments are computed right before the prompt is
+// drawn. Expensive ones are marked 'is_async' and computed on a background worker
+// thread: the prompt is drawn at once with the last value computed for the current
+// directory, and redrawn when a fresh value arrives. Reading input never waits for
+// a segment.
+//
+// Built-in segments:
+//   git       The branch (or short commit) of the enclosing git repository, with a
+//             '*' when tracked files have changes. Empty outside a repository.
+//   duration  How long the last command line took to run.
+
+#define PROMPT_SEGMENT_MAX_TEXT 256
+
+typedef struct {
+    const char *name;
+    bool is_async;
+    // Writes the segment's text for the shell's directory 'cwd' into 'out', which
+    // holds PROMPT_SEGMENT_MAX_TEXT bytes. An async segment runs on the worker
+    // thread, so it must not touch the shell's state; it only gets its arguments.
+    void (*compute)(const char *cwd, char *out, size_t out_size);
+} PromptSegment;
+
+// Adds a segment. 'segment' must stay valid while the shell runs.
+// Returns false if a segment of the same name exists or the table is full.
+bool register_prompt_segment(const PromptSegment *segment);
+
+// Registers the built-in segments and starts the worker thread.
+void init_prompt_segments(void);
+
+// Brings the segments used by 'format' up to date for 'cwd': synchronous ones are
+// computed now, and async ones are handed to the worker without waiting for it.
+// Returns true if any value changed.
+bool refresh_prompt_segments(const char *format, const char *cwd);
+
+// Copies the current value of the segment named by the first 'name_len' bytes of
+// 'name' into 'out'. An async value computed for a directory other than 'cwd' is
+// not shown. Unknown names give an empty string.
+void prompt_segment_value(const char *name, size_t name_len, const char *cwd, char *out, size_t out_size);
+
+// An fd that becomes readable when the worker has produced new values.
+int prompt_segments_event_fd(void);
+
+// Drains the event fd. Returns true if any value changed since the last call.
+bool process_prompt_segment_events(void);
+
+// Records how long the last command line took, for the 'duration' segment.
+void prompt_segments_set_duration(double seconds);
+
+// Stops the worker thread. A computation in progress is not waited for.
+void cleanup_prompt_segments(void);
+
+#endif // PROMPT_SEGMENTS_H
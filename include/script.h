@@ -0,0 +1,13 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+// Runs every line of the script file at 'path' without prompting or touching history.
+// Blank lines and lines starting with '#' (including a '#!' line) are skipped.
+// Returns the exit status of the last command, or 1 if the file could not be read.
+int run_script_file(const char *path, const char *home_dir);
+
+// Runs the newline-separated command lines in 'commands' (for 'shell.out -c ...').
+// Returns the exit status of the last command.
+int run_script_string(const char *commands, const char *home_dir);
+
+#endif // SCRIPT_H
@@ -2,6 +2,8 @@
 #define TOKENIZER_H
 
 #include <stddef.h> // For size_t
+#include <stdbool.h>
+#include "arena.h"
 
 // Defines all the possible types of tokens in your shell language.
 typedef enum {
@@ -12,6 +14,7 @@ typedef enum {
     TOKEN_REDIRECT_APPEND,  // >>
     TOKEN_AMPERSAND,        // &
     TOKEN_AND_IF,           // &&
+    TOKEN_OR_IF,            // ||
     TOKEN_SEMICOLON,        // ; (not in the grammar, but must be tokenized)
     TOKEN_EOL,              // End of Line/Input
     TOKEN_INVALID           // An unrecognized character
@@ -24,10 +27,20 @@ typedef struct {
 } Token;
 
 // Tokenizes a given command string into a list of tokens.
-// The caller is responsible for freeing the list with free_tokens().
-Token* tokenize(const char *input, int *token_count);
+// The token array and all of its name strings are one allocation from 'arena',
+// and stay valid until the arena is reset.
+Token* tokenize(Arena *arena, const char *input, int *token_count);
 
-// Frees the memory allocated for a list of tokens.
-void free_tokens(Token *tokens, int token_count);
+// The implementations available for finding the end of a name token.
+typedef enum {
+    SCAN_AUTO,    // The fastest one the CPU supports (the default)
+    SCAN_SCALAR,  // One byte at a time, via a lookup table
+    SCAN_SSE2,    // 16 bytes at a time
+    SCAN_AVX2     // 32 bytes at a time, if the CPU supports AVX2
+} ScanMode;
+
+// Selects the scanner used by tokenize(). Mainly useful for benchmarks.
+// Returns false if the requested scanner is not available on this machine.
+bool tokenizer_set_scan_mode(ScanMode mode);
 
 #endif // TOKENIZER_H
\ No newline at end of file
@@ -0,0 +1,37 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tracing of the shell's own work, for profiling command launch latency. When
+// $MINI_SHELL_TRACE names a file at startup, every traced step (tokenizing,
+// parsing, expanding, spawning, waiting...) is written to it as a span in the
+// Chrome trace-event JSON format, which chrome://tracing and Perfetto can open.
+//
+// Spans are formatted into a buffer and written out when it fills, after each
+// interactive command line and at exit, so tracing costs no system call per span.
+// If the shell is killed, the file lacks its closing ']', which the trace-event
+// format allows. With tracing off, a span is a single branch.
+
+// Set while tracing is on.
+extern bool g_tracing;
+
+// Opens the trace file named by $MINI_SHELL_TRACE, if it is set.
+void init_trace(void);
+
+// Returns the start time of a span beginning now, or 0 if tracing is off.
+uint64_t trace_begin(void);
+
+// Records the span 'name' that began at 'start' (from trace_begin()) and ends now.
+// 'detail' is shown with it (e.g. the command), or NULL. Does nothing if 'start'
+// is 0. 'name' must be a plain string that needs no JSON escaping.
+void trace_end(const char *name, uint64_t start, const char *detail);
+
+// Writes out the spans recorded so far.
+void trace_flush(void);
+
+// Writes out the remaining spans and closes the trace file.
+void cleanup_trace(void);
+
+#endif // TRACE_H
@@ -0,0 +1,73 @@
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <sys/types.h> // For pid_t
+#include <time.h>
+
+// Resource accounting for commands. The kernel reports the CPU time, peak memory
+// and context switches of each child when it is reaped with wait4(), so every
+// wait in the shell goes through this module. The 'time' prefix reports on one
+// pipeline, and with $MINI_SHELL_TIMING set every command line and background job
+// is measured: jobs show their usage in 'activities' and when they finish, and
+// command lines keep theirs with the history entry ('log times').
+
+// What a command used.
+typedef struct {
+    double real_seconds;       // Wall-clock time
+    double user_seconds;       // CPU time in user mode
+    double system_seconds;     // CPU time in the kernel
+    long max_rss_kb;           // Largest resident set of any one process
+    long voluntary_switches;   // Waits for I/O or another process
+    long involuntary_switches; // Preemptions by the scheduler
+} ResourceUsage;
+
+// Measures the foreground work done between usage_timer_start() and
+// usage_timer_stop(): the children reaped with wait_for_foreground() in between,
+// plus the shell's own CPU time for built-ins. Timers may be nested.
+typedef struct {
+    struct timespec started;
+    ResourceUsage shell;       // The shell's own usage when the timer started
+    ResourceUsage children;    // Foreground children's totals when the timer started
+    long saved_peak_rss;       // The enclosing timer's peak, restored on stop
+    int children_reaped;       // Foreground children reaped when the timer started
+    int first_stage;           // First stage record that belongs to this timer
+} UsageTimer;
+
+// Waits like waitpid(), and stores what a terminated child used in 'usage'.
+// Its 'real_seconds' is left 0, since the kernel does not know when it started.
+pid_t wait_with_usage(pid_t pid, int *status, int options, ResourceUsage *usage);
+
+// Waits like waitpid() for a foreground child, counting what it used towards the
+// running timers. 'name' labels the process in a 'time' report (NULL for none).
+pid_t wait_for_foreground(pid_t pid, int *status, int options, const char *name);
+
+void usage_timer_start(UsageTimer *timer);
+void usage_timer_stop(UsageTimer *timer, ResourceUsage *usage);
+
+// Stops 'timer' and prints its usage to stderr, followed by one line per process
+// when more than one was reaped (the stages of a pipeline).
+void report_usage(UsageTimer *timer);
+
+// Adds 'part' to 'total': times and switches are summed, and the peak memory and
+// wall-clock time are the larger of the two, since the parts may have overlapped.
+void add_usage(ResourceUsage *total, const ResourceUsage *part);
+
+// Formats 'usage' as "real 1.204s user 0.950s sys 0.031s maxrss 5120KB csw 12/3"
+// (context switches are voluntary/involuntary).
+void format_usage(const ResourceUsage *usage, char *out, size_t size);
+
+// Returns the seconds elapsed since 'start' (taken with CLOCK_MONOTONIC).
+double seconds_since(const struct timespec *start);
+
+// Returns true if every command line and job should be measured: $MINI_SHELL_TIMING
+// is set to anything but "" or "0".
+bool usage_tracking_enabled(void);
+
+// The history entry the usage of the command line being run is recorded against,
+// or -1 if none. Background jobs take it when they start.
+long get_usage_history_entry(void);
+void set_usage_history_entry(long entry_id);
+
+#endif // USAGE_H
@@ -0,0 +1,63 @@
+#ifndef VARIABLES_H
+#define VARIABLES_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "arena.h"
+
+// Shell variables and the environment, in one hash table. Variables come from the
+// environment the shell was started with, 'NAME=value' commands, 'export' and 'for'
+// loops, and are expanded from "$NAME" and "${NAME}" in words.
+//
+// Exported variables make up the environment of every program the shell starts.
+// That environment is kept as a ready-to-use envp array, updated in place whenever
+// a variable changes, and the shell's own environ (and so getenv()) points at it.
+
+// Imports the shell's environment as exported variables. Call once at startup.
+void init_variables(void);
+
+// Sets a shell variable, replacing any previous value. An exported variable's
+// new value goes into the environment.
+void set_variable(const char *name, const char *value);
+
+// Like set_variable(), for a name given as its first 'name_len' bytes.
+void set_variable_n(const char *name, size_t name_len, const char *value);
+
+// Returns the value of the variable whose name is the first 'name_len' bytes of
+// 'name', or NULL if it is not set. The returned string is only valid until the
+// variable is next changed.
+const char* get_variable(const char *name, size_t name_len);
+
+// Marks a variable for export. A name without a value joins the environment once
+// it is given one.
+void export_variable(const char *name);
+
+// Removes a variable, and takes it out of the environment.
+void unset_variable(const char *name);
+
+// Returns the environment for a new process, NULL-terminated. It is only valid
+// until the next change to a variable.
+char** variables_environment(void);
+
+// Returns the environment with the "NAME=value" strings in 'assignments' added or
+// replacing the variables of the same name, for 'NAME=value cmd'. The array is
+// allocated from 'arena'.
+char** variables_environment_with(char *const *assignments, int count, Arena *arena);
+
+// Prints every exported variable as "export NAME=value", sorted by name.
+void print_exported_variables(void);
+
+// Returns true if 'name' is a valid variable name: a letter or '_' followed by
+// letters, digits and '_'.
+bool is_valid_variable_name(const char *name);
+
+// Returns the length of the variable name at the start of 'str' (0 if none).
+size_t variable_name_length(const char *str);
+
+// Returns true if 'word' has the form NAME=value.
+bool is_assignment(const char *word);
+
+// Frees all memory used by the variable table and restores the original environ.
+void cleanup_variables(void);
+
+#endif // VARIABLES_H
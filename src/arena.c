@@ -0,0 +1,150 @@
+#include "arena.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Arena Data Structures ---
+
+struct ArenaBlock {
+    ArenaBlock *next;  // The previous (older) block
+    size_t size;       // Usable bytes in data[]
+    size_t used;       // Bytes handed out from data[]
+    // Followed by the usable bytes, aligned like the header itself.
+};
+
+// Every allocation is rounded up to this so that any type can be stored.
+#define ARENA_ALIGNMENT 16
+#define ARENA_MIN_BLOCK (16 * 1024)
+// A kept block more than this many times larger than recent use is shrunk.
+#define ARENA_SHRINK_FACTOR 4
+// Size of the block header, rounded up so data[] starts aligned.
+#define ARENA_HEADER_SIZE ((sizeof(ArenaBlock) + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1))
+
+Arena g_line_arena = {NULL, 0, 0, 0, 0};
+static ArenaStatsHook g_stats_hook = NULL;
+
+// --- Private Helper Functions ---
+
+static char* block_data(ArenaBlock *block) {
+    return (char *)block + ARENA_HEADER_SIZE;
+}
+
+static ArenaBlock* new_block(const Arena *arena, size_t min_size) {
+    size_t smallest = arena->block_size ? arena->block_size : ARENA_MIN_BLOCK;
+    size_t size = (min_size < smallest) ? smallest : min_size;
+    ArenaBlock *block = malloc(ARENA_HEADER_SIZE + size);
+    if (!block) {
+        perror("malloc for arena");
+        exit(EXIT_FAILURE);
+    }
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+// --- Public API Implementation ---
+
+void* arena_alloc(Arena *arena, size_t size) {
+    size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+    if (size == 0) size = ARENA_ALIGNMENT;
+
+    ArenaBlock *block = arena->blocks;
+    if (!block || block->size - block->used < size) {
+        // Grow geometrically so a large line needs only a few blocks.
+        size_t want = block ? block->size * 2 : 0;
+        if (want < size) want = size;
+        block = new_block(arena, want);
+        block->next = arena->blocks;
+        arena->blocks = block;
+    }
+
+    void *ptr = block_data(block) + block->used;
+    block->used += size;
+    arena->bytes += size;
+    arena->allocations++;
+    return ptr;
+}
+
+char* arena_strdup(Arena *arena, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = arena_alloc(arena, len);
+    memcpy(copy, str, len);
+    return copy;
+}
+
+ArenaMark arena_mark(const Arena *arena) {
+    ArenaMark mark = {arena->blocks, arena->blocks ? arena->blocks->used : 0, arena->bytes, arena->allocations};
+    return mark;
+}
+
+void arena_release_to(Arena *arena, ArenaMark mark) {
+    // Free the blocks added since the mark, except that an arena which was empty
+    // keeps its oldest block for the next round.
+    while (arena->blocks != mark.block && (mark.block || arena->blocks->next)) {
+        ArenaBlock *next = arena->blocks->next;
+        free(arena->blocks);
+        arena->blocks = next;
+    }
+    if (arena->blocks) {
+        arena->blocks->used = mark.used;
+    }
+    arena->bytes = mark.bytes;
+    arena->allocations = mark.allocations;
+}
+
+void arena_reset(Arena *arena) {
+    if (!arena->blocks) return;
+
+    // Recent use decays by half at every reset, so one huge line is soon forgotten.
+    size_t decayed = arena->recent_bytes / 2;
+    arena->recent_bytes = (arena->bytes > decayed) ? arena->bytes : decayed;
+
+    if (arena->blocks->next) {
+        // The last line needed several blocks: replace them with one big enough
+        // for all of it, so the next similar line needs only one.
+        size_t total = 0;
+        for (ArenaBlock *b = arena->blocks; b; b = b->next) total += b->size;
+        arena_destroy(arena);
+        arena->blocks = new_block(arena, total);
+    } else if (arena->blocks->size / ARENA_SHRINK_FACTOR > arena->recent_bytes &&
+               arena->blocks->size > (arena->block_size ? arena->block_size : ARENA_MIN_BLOCK)) {
+        // The block was sized for a line much larger than the recent ones.
+        arena_destroy(arena);
+        arena->blocks = new_block(arena, arena->recent_bytes);
+    }
+    arena->blocks->used = 0;
+    arena->bytes = 0;
+    arena->allocations = 0;
+}
+
+void arena_destroy(Arena *arena) {
+    ArenaBlock *block = arena->blocks;
+    while (block) {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    arena->blocks = NULL;
+    arena->bytes = 0;
+    arena->allocations = 0;
+}
+
+void line_arena_finish(void) {
+    if (g_stats_hook) {
+        ArenaStats stats = {g_line_arena.bytes, g_line_arena.allocations, 0};
+        for (ArenaBlock *b = g_line_arena.blocks; b; b = b->next) {
+            stats.reserved += b->size;
+        }
+        g_stats_hook(&stats);
+    }
+    arena_reset(&g_line_arena);
+}
+
+void line_arena_set_stats_hook(ArenaStatsHook hook) {
+    g_stats_hook = hook;
+}
+
+void cleanup_line_arena(void) {
+    arena_destroy(&g_line_arena);
+}
@@ -7,13 +7,27 @@
 #include <stdbool.h>
 #include "history.h"
 #include "jobs.h"
+#include "command_hash.h"
+#include "variables.h"
+#include "prompt.h"
+#include "arena.h"
 #include <signal.h> // For kill()
 #include <errno.h>  // For errno and ESRCH
 // Static variable to store the previous working directory for 'hop -'.
 // It's initialized to be empty.
 static char previous_cwd[1024] = "";
 
-void handle_hop(Token *tokens, int token_count, const char *home_dir) {
+// Tells the prompt about the new working directory after a successful chdir.
+static void note_directory_change(void) {
+    char cwd[1024];
+    if (getcwd(cwd, sizeof(cwd)) == NULL) {
+        perror("hop: getcwd");
+        return;
+    }
+    prompt_set_cwd(cwd);
+}
+
+int handle_hop(Token *tokens, int token_count, const char *home_dir) {
     // Step 1: Handle 'hop' with no arguments.
     // If token_count is 2 (only 'hop' and 'EOL'), it means no arguments were provided.
     // This is equivalent to 'hop ~'.
@@ -23,11 +37,15 @@ void handle_hop(Token *tokens, int token_count, const char *home_dir) {
         }
         if(chdir(home_dir) == -1) {
             printf("No such directory!\n");
+            return 1;
         }
-        return;
+        note_directory_change();
+        return 0;
     }
 
     // Step 2: Loop through all the arguments provided to 'hop'.
+    // The status is 1 if any of them could not be applied.
+    int status = 0;
     // The arguments start at index 1 (index 0 is the command 'hop' itself).
     for (int i = 1; i < token_count - 1; i++) {
         const char *arg = tokens[i].value;
@@ -44,7 +62,8 @@ void handle_hop(Token *tokens, int token_count, const char *home_dir) {
             if (getcwd(current_cwd_buffer, sizeof(current_cwd_buffer)) == NULL) {
                 perror("hop: getcwd");
             } else {
-                strncpy(previous_cwd, current_cwd_buffer, sizeof(previous_cwd) - 1);
+                // Both buffers are the same size, so this copies the whole path.
+                memcpy(previous_cwd, current_cwd_buffer, sizeof(previous_cwd));
             }
             do_chdir = 0;
         } else if (strcmp(arg, "..") == 0) {
@@ -53,8 +72,9 @@ void handle_hop(Token *tokens, int token_count, const char *home_dir) {
             if (strlen(previous_cwd) == 0) {
                 printf("hop: previous directory not set\n");
                 do_chdir = 0;
+                status = 1;
             } else {
-                strncpy(target_path, previous_cwd, sizeof(target_path) - 1);
+                memcpy(target_path, previous_cwd, sizeof(target_path));
                 // For '-', we print the new directory after changing.
                 puts(target_path);
             }
@@ -71,18 +91,22 @@ void handle_hop(Token *tokens, int token_count, const char *home_dir) {
             if (getcwd(current_cwd_buffer, sizeof(current_cwd_buffer)) == NULL) {
                 perror("hop: getcwd");
                 // Continue to the next argument even if getcwd fails
-                continue; 
+                status = 1;
+                continue;
             }
 
             if (chdir(target_path) == -1) {
                 printf("No such directory!\n");
+                status = 1;
             } else {
                 // Only update previous_cwd on a successful change.
                 strncpy(previous_cwd, current_cwd_buffer, sizeof(previous_cwd) - 1);
                 previous_cwd[sizeof(previous_cwd) - 1] = '\0';
+                note_directory_change();
             }
         }
     }
+    return status;
 }
 
 // Comparison function for qsort
@@ -90,7 +114,7 @@ static int compare_strings(const void *a, const void *b) {
     return strcmp(*(const char **)a, *(const char **)b);
 }
 
-void handle_reveal(Token *tokens, int token_count, const char *home_dir) {
+int handle_reveal(Token *tokens, int token_count, const char *home_dir) {
     // --- Phase A: Argument Parsing ---
     bool show_all = false;
     bool list_format = false;
@@ -108,7 +132,7 @@ void handle_reveal(Token *tokens, int token_count, const char *home_dir) {
                     list_format = true;
                 } else {
                     fprintf(stderr, "reveal: Invalid Syntax!\n");
-                    return;
+                    return 1;
                 }
             }
         } else {
@@ -116,7 +140,7 @@ void handle_reveal(Token *tokens, int token_count, const char *home_dir) {
             if (path_arg != NULL) {
                 // We've already seen a path argument. This is an error.
                 fprintf(stderr, "reveal: Invalid Syntax!\n");
-                return;
+                return 1;
             }
             path_found = true;
             path_arg = arg;
@@ -129,7 +153,7 @@ void handle_reveal(Token *tokens, int token_count, const char *home_dir) {
         // No path provided, use current directory
         if (getcwd(final_path, sizeof(final_path)) == NULL) {
             perror("reveal: getcwd");
-            return;
+            return 1;
         }
     } else {
         // Resolve path argument, similar to 'hop'
@@ -138,16 +162,16 @@ void handle_reveal(Token *tokens, int token_count, const char *home_dir) {
         } else if (strcmp(path_arg, ".") == 0) {
             if (getcwd(final_path, sizeof(final_path)) == NULL) {
                 perror("reveal: getcwd");
-                return;
+                return 1;
             }
         } else if (strcmp(path_arg, "..") == 0) {
             strncpy(final_path, "..", sizeof(final_path) - 1);
         } else if (strcmp(path_arg, "-") == 0) {
             if (strlen(previous_cwd) == 0) {
                 printf("No such directory!\n");
-                return;
+                return 1;
             }
-            strncpy(final_path, previous_cwd, sizeof(final_path) - 1);
+            memcpy(final_path, previous_cwd, sizeof(final_path));
         } else if (path_arg[0] == '~') {
             snprintf(final_path, sizeof(final_path), "%s%s", home_dir, path_arg + 1);
         } else {
@@ -159,7 +183,7 @@ void handle_reveal(Token *tokens, int token_count, const char *home_dir) {
     DIR *dir_stream = opendir(final_path);
     if (dir_stream == NULL) {
         fprintf(stderr, "No such directory!\n");
-        return;
+        return 1;
     }
 
     char **entries = NULL;
@@ -206,13 +230,14 @@ void handle_reveal(Token *tokens, int token_count, const char *home_dir) {
         free(entries[i]);
     }
     free(entries);
+    return 0;
 }
 
-void handle_log(Token *tokens, int token_count) {
+int handle_log(Token *tokens, int token_count) {
     // Case 1: 'log' with no arguments
     if (token_count <= 2) {
         print_history();
-        return;
+        return 0;
     }
 
     // Check the subcommand
@@ -223,21 +248,72 @@ void handle_log(Token *tokens, int token_count) {
     // context (e.g., in a pipeline), so we should report an error.
     if (strcmp(subcommand, "execute") == 0) {
         printf("log: Invalid Syntax!\n");
-        return;
+        return 1;
+    }
+
+    // 'log search [-p] <pattern>' finds past commands. The remaining words are
+    // joined with single spaces, so multi-word patterns need no quoting.
+    if (strcmp(subcommand, "search") == 0) {
+        int first = 2;
+        bool prefix_only = false;
+        if (first < token_count - 1 && strcmp(tokens[first].value, "-p") == 0) {
+            prefix_only = true;
+            first++;
+        }
+        if (first >= token_count - 1) {
+            printf("log: Invalid Syntax!\n");
+            return 1;
+        }
+        size_t len = 0;
+        for (int i = first; i < token_count - 1; i++) {
+            len += strlen(tokens[i].value) + 1;
+        }
+        char *pattern = arena_alloc(&g_line_arena, len);
+        pattern[0] = '\0';
+        for (int i = first; i < token_count - 1; i++) {
+            if (i > first) strcat(pattern, " ");
+            strcat(pattern, tokens[i].value);
+        }
+        search_history(pattern, prefix_only);
+        return 0;
+    }
+
+    // 'log size' reports the history size and 'log size N' changes it.
+    if (strcmp(subcommand, "size") == 0) {
+        if (token_count == 3) {
+            printf("%d\n", get_history_size());
+            return 0;
+        }
+        char *endptr;
+        long size = strtol(tokens[2].value, &endptr, 10);
+        if (token_count != 4 || *endptr != '\0' || !set_history_size((int)size)) {
+            printf("log: Invalid Syntax!\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    // 'log times' lists history with what each command line used, when
+    // $MINI_SHELL_TIMING was set while it ran.
+    if (strcmp(subcommand, "times") == 0 && token_count == 3) {
+        print_history_usage();
+        return 0;
     }
 
     printf("log: invalid subcommand '%s'\n", subcommand);
+    return 1;
 }
 
-void handle_activities(void) {
+int handle_activities(void) {
     list_activities();
+    return 0;
 }
 
-void handle_ping(Token *tokens, int token_count) {
+int handle_ping(Token *tokens, int token_count) {
     // 1. Argument Validation: Must be 'ping <pid> <signal_number>'
     if (token_count != 4) { // command, pid, signal, EOL
         printf("Invalid syntax!\n");
-        return;
+        return 1;
     }
 
     // 2. Argument Conversion using strtol for better error checking
@@ -248,7 +324,7 @@ void handle_ping(Token *tokens, int token_count) {
     // Check for conversion errors (e.g., non-numeric input)
     if (*endptr_pid != '\0' || *endptr_sig != '\0') {
         printf("Invalid syntax!\n");
-        return;
+        return 1;
     }
 
     // 3. Signal Calculation as per requirement
@@ -258,17 +334,18 @@ void handle_ping(Token *tokens, int token_count) {
     if (kill((pid_t)pid_val, actual_signal) == 0) {
         // Success case
         printf("Sent signal %ld to process with pid %ld\n", sig_val, pid_val);
+        return 0;
+    }
+    // Error case: Check errno to determine the cause
+    if (errno == ESRCH) {
+        printf("No such process found\n");
     } else {
-        // Error case: Check errno to determine the cause
-        if (errno == ESRCH) {
-            printf("No such process found\n");
-        } else {
-            perror("ping"); // For other errors like permissions
-        }
+        perror("ping"); // For other errors like permissions
     }
+    return 1;
 }
 
-void handle_fg(Token *tokens, int token_count) {
+int handle_fg(Token *tokens, int token_count) {
     int job_id = 0;
     bool use_default_job = true;
 
@@ -276,20 +353,20 @@ void handle_fg(Token *tokens, int token_count) {
     if (token_count > 2) { // 'fg', [job_id], EOL
         if (token_count > 3) {
             fprintf(stderr, "fg: too many arguments\n");
-            return;
+            return 1;
         }
         char *endptr;
         job_id = strtol(tokens[1].value, &endptr, 10);
         if (*endptr != '\0') {
             fprintf(stderr, "fg: job id must be a number\n");
-            return;
+            return 1;
         }
         use_default_job = false;
     }
-    continue_job_in_foreground(job_id, use_default_job);
+    return continue_job_in_foreground(job_id, use_default_job);
 }
 
-void handle_bg(Token *tokens, int token_count) {
+int handle_bg(Token *tokens, int token_count) {
     int job_id = 0;
     bool use_default_job = true;
 
@@ -297,15 +374,125 @@ void handle_bg(Token *tokens, int token_count) {
     if (token_count > 2) { // 'bg', [job_id], EOL
         if (token_count > 3) {
             fprintf(stderr, "bg: too many arguments\n");
-            return;
+            return 1;
         }
         char *endptr;
         job_id = strtol(tokens[1].value, &endptr, 10);
         if (*endptr != '\0') {
             fprintf(stderr, "bg: job id must be a number\n");
-            return;
+            return 1;
         }
         use_default_job = false;
     }
-    continue_job_in_background(job_id, use_default_job);
-}
\ No newline at end of file
+    return continue_job_in_background(job_id, use_default_job);
+}
+
+int handle_jobs(Token *tokens, int token_count) {
+    // Case 1: 'jobs' lists active jobs followed by commands waiting for a slot.
+    if (token_count <= 2) {
+        list_activities();
+        list_queued_jobs();
+        return 0;
+    }
+
+    if (strcmp(tokens[1].value, "-j") != 0 || token_count > 4) {
+        printf("jobs: Invalid Syntax!\n");
+        return 1;
+    }
+
+    // Case 2: 'jobs -j' shows the job-slot limit.
+    if (token_count == 3) {
+        int limit = get_max_running_jobs();
+        if (limit == 0) {
+            printf("unlimited\n");
+        } else {
+            printf("%d\n", limit);
+        }
+        return 0;
+    }
+
+    // Case 3: 'jobs -j N' caps running background jobs at N (0 removes the cap).
+    char *endptr;
+    long limit = strtol(tokens[2].value, &endptr, 10);
+    if (*endptr != '\0' || tokens[2].value[0] == '\0' || limit < 0 || limit > 1000000) {
+        printf("jobs: Invalid Syntax!\n");
+        return 1;
+    }
+    set_max_running_jobs((int)limit);
+    return 0;
+}
+
+int handle_hash(Token *tokens, int token_count) {
+    // Case 1: 'hash' with no arguments lists the table.
+    if (token_count <= 2) {
+        hash_print();
+        return 0;
+    }
+
+    // Case 2: 'hash -r' forgets every remembered location.
+    if (strcmp(tokens[1].value, "-r") == 0) {
+        if (token_count > 3) {
+            fprintf(stderr, "hash: too many arguments\n");
+            return 1;
+        }
+        hash_clear();
+        return 0;
+    }
+
+    // Case 3: 'hash name...' looks each name up and remembers it.
+    int status = 0;
+    for (int i = 1; i < token_count - 1; i++) {
+        if (hash_lookup_command(tokens[i].value) == NULL) {
+            fprintf(stderr, "hash: %s: not found\n", tokens[i].value);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+int handle_export(Token *tokens, int token_count) {
+    // Case 1: 'export' with no arguments lists the environment.
+    if (token_count <= 2) {
+        print_exported_variables();
+        return 0;
+    }
+
+    // Case 2: 'export NAME[=value]...' marks each name for export, setting it first if given a value.
+    int status = 0;
+    for (int i = 1; i < token_count - 1; i++) {
+        if (tokens[i].type != TOKEN_NAME) {
+            continue;
+        }
+        const char *word = tokens[i].value;
+        size_t name_len = variable_name_length(word);
+        if (name_len == 0 || (word[name_len] != '\0' && word[name_len] != '=')) {
+            fprintf(stderr, "export: '%s': not a valid identifier\n", word);
+            status = 1;
+            continue;
+        }
+        if (word[name_len] == '=') {
+            set_variable_n(word, name_len, word + name_len + 1);
+        }
+        char *name = arena_alloc(&g_line_arena, name_len + 1);
+        memcpy(name, word, name_len);
+        name[name_len] = '\0';
+        export_variable(name);
+    }
+    return status;
+}
+
+int handle_unset(Token *tokens, int token_count) {
+    int status = 0;
+    for (int i = 1; i < token_count - 1; i++) {
+        if (tokens[i].type != TOKEN_NAME) {
+            continue;
+        }
+        if (!is_valid_variable_name(tokens[i].value)) {
+            fprintf(stderr, "unset: '%s': not a valid identifier\n", tokens[i].value);
+            status = 1;
+            continue;
+        }
+        unset_variable(tokens[i].value);
+    }
+    return status;
+}
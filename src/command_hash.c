@@ -0,0 +1,194 @@
+#include "command_hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "variables.h"
+
+// --- Hash Table Data Structures ---
+
+typedef struct HashEntry {
+    char *name;             // The command name as typed, e.g. "grep"
+    char *path;             // The resolved absolute path, e.g. "/usr/bin/grep"
+    int hits;               // How many times this entry was used
+    struct HashEntry *next; // Next entry in the same bucket
+} HashEntry;
+
+#define HASH_BUCKETS 64
+
+static HashEntry *g_buckets[HASH_BUCKETS];
+static int g_entry_count = 0;
+// The value of $PATH the current entries were resolved against.
+static char *g_cached_path_var = NULL;
+// Holds the result of a lookup that must not be cached (relative $PATH entries).
+static char g_uncached_result[4096];
+
+// --- Private Helper Functions ---
+
+// djb2 string hash.
+static unsigned int hash_name(const char *name) {
+    unsigned int hash = 5381;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) {
+        hash = hash * 33 + *p;
+    }
+    return hash % HASH_BUCKETS;
+}
+
+static HashEntry* find_entry(const char *name) {
+    for (HashEntry *entry = g_buckets[hash_name(name)]; entry; entry = entry->next) {
+        if (strcmp(entry->name, name) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Returns true if 'path' names an executable regular file.
+static bool is_executable_file(const char *path) {
+    struct stat st;
+    return access(path, X_OK) == 0 && stat(path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+// Returns the search path used when $PATH is unset: the system's default, as
+// execvp() uses.
+static const char* default_search_path(void) {
+    static char path[256];
+    if (path[0] == '\0') {
+        size_t len = confstr(_CS_PATH, path, sizeof(path));
+        if (len == 0 || len > sizeof(path)) {
+            snprintf(path, sizeof(path), "/bin:/usr/bin");
+        }
+    }
+    return path;
+}
+
+// Flushes the table if $PATH changed since the entries were resolved.
+static void validate_path_variable(void) {
+    const char *path_var = get_variable("PATH", 4);
+    if (!path_var) path_var = default_search_path();
+    if (g_cached_path_var && strcmp(g_cached_path_var, path_var) == 0) {
+        return;
+    }
+    hash_clear();
+    free(g_cached_path_var);
+    g_cached_path_var = strdup(path_var);
+}
+
+// Walks $PATH looking for 'name'. On success the full path is written to 'out'
+// and 'cacheable' reports whether it came from an absolute directory.
+static bool search_path(const char *name, char *out, size_t out_size, bool *cacheable) {
+    const char *dir = g_cached_path_var ? g_cached_path_var : "";
+    while (true) {
+        const char *end = strchr(dir, ':');
+        size_t dir_len = end ? (size_t)(end - dir) : strlen(dir);
+
+        // An empty component means the current directory.
+        if (dir_len == 0) {
+            snprintf(out, out_size, "%s", name);
+        } else {
+            snprintf(out, out_size, "%.*s/%s", (int)dir_len, dir, name);
+        }
+        if (is_executable_file(out)) {
+            *cacheable = (dir_len > 0 && dir[0] == '/');
+            if (dir_len == 0) {
+                // Make sure execve does not search $PATH again for the bare name.
+                snprintf(out, out_size, "./%s", name);
+            }
+            return true;
+        }
+
+        if (!end) break;
+        dir = end + 1;
+    }
+    return false;
+}
+
+// --- Public API Implementation ---
+
+const char* hash_lookup_command(const char *name) {
+    if (strchr(name, '/')) {
+        return name;
+    }
+
+    validate_path_variable();
+
+    HashEntry *entry = find_entry(name);
+    if (entry) {
+        entry->hits++;
+        return entry->path;
+    }
+
+    bool cacheable = false;
+    if (!search_path(name, g_uncached_result, sizeof(g_uncached_result), &cacheable)) {
+        return NULL;
+    }
+    if (!cacheable) {
+        return g_uncached_result;
+    }
+
+    entry = malloc(sizeof(HashEntry));
+    if (!entry) {
+        perror("malloc");
+        return g_uncached_result;
+    }
+    entry->name = strdup(name);
+    entry->path = strdup(g_uncached_result);
+    entry->hits = 1;
+    unsigned int bucket = hash_name(name);
+    entry->next = g_buckets[bucket];
+    g_buckets[bucket] = entry;
+    g_entry_count++;
+    return entry->path;
+}
+
+void hash_forget_command(const char *name) {
+    HashEntry **link = &g_buckets[hash_name(name)];
+    while (*link) {
+        HashEntry *entry = *link;
+        if (strcmp(entry->name, name) == 0) {
+            *link = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            g_entry_count--;
+            return;
+        }
+        link = &entry->next;
+    }
+}
+
+void hash_clear(void) {
+    for (int i = 0; i < HASH_BUCKETS; i++) {
+        HashEntry *entry = g_buckets[i];
+        while (entry) {
+            HashEntry *next = entry->next;
+            free(entry->name);
+            free(entry->path);
+            free(entry);
+            entry = next;
+        }
+        g_buckets[i] = NULL;
+    }
+    g_entry_count = 0;
+}
+
+void hash_print(void) {
+    if (g_entry_count == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    printf("hits\tcommand\n");
+    for (int i = 0; i < HASH_BUCKETS; i++) {
+        for (HashEntry *entry = g_buckets[i]; entry; entry = entry->next) {
+            printf("%4d\t%s\n", entry->hits, entry->path);
+        }
+    }
+}
+
+void cleanup_command_hash(void) {
+    hash_clear();
+    free(g_cached_path_var);
+    g_cached_path_var = NULL;
+}
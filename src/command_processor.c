@@ -4,334 +4,610 @@
 #include <string.h>
 #include <unistd.h> 
 #include <fcntl.h>  
+#include <signal.h>
 #include "tokenizer.h"
 #include "parser.h"
+#include "plan_cache.h"
+#include "variables.h"
 #include "builtins.h"
 #include "history.h"
 #include "pipeline.h"
+#include "arena.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "job_control.h"
+#include "usage.h"
+#include "trace.h"
 
-// Forward declaration for the function that handles a single command group.
-static void execute_single_command(Token *tokens, int token_count, const char *home_dir, bool is_background);
+// Exit status of the most recent command, reported by '$?'.
+static int g_last_status = 0;
+// Set when a foreground command is killed by Ctrl-C; the rest of the command line,
+// including any enclosing loops, is abandoned, as bash does.
+static bool g_interrupted = false;
 
-// Reconstructs a user-facing command string from a list of tokens.
-// This is used for storing the full command for job control messages.
-static char* reconstruct_command_string(Token *tokens, int token_count) {
-    if (token_count <= 1) return strdup("");
+// Forward declarations for the functions that run the nodes of a plan.
+static int execute_pipeline_node(const PlanPipeline *pipeline, const char *home_dir, bool is_background);
+static void execute_list(const PlanList *list, const char *home_dir);
+static void execute_and_or(const PlanAndOr *and_or, const char *home_dir);
 
-    // Calculate the required buffer size for the full command string.
+// Finds the value of the parameter referenced by the '$' at 'p': "$?", "$NAME" or
+// "${NAME}". Sets '*ref_len' to the length of the reference ('$' included), or to 0
+// if 'p' is not a reference and the '$' is taken literally. Unset variables are empty.
+// A NULL 'status' leaves "$?" as it is, to be expanded later.
+static const char* lookup_parameter(const char *p, size_t *ref_len, const char *status) {
+    if (p[1] == '?') {
+        *ref_len = status ? 2 : 0;
+        return status;
+    }
+    bool braced = (p[1] == '{');
+    const char *name = p + (braced ? 2 : 1);
+    size_t name_len = variable_name_length(name);
+    if (!name_len || (braced && name[name_len] != '}')) {
+        *ref_len = 0;
+        return NULL;
+    }
+    *ref_len = name_len + (braced ? 3 : 1);
+    const char *value = get_variable(name, name_len);
+    return value ? value : "";
+}
+
+// Returns 'word' with every "$?" replaced by 'status' (or kept, if it is NULL)
+// and every "$NAME" or "${NAME}" by the variable's value. Expanded words come
+// from the line arena.
+static const char* expand_word_with_status(const char *word, const char *status) {
+    if (!strchr(word, '$')) {
+        return word;
+    }
     size_t len = 0;
-    for (int i = 0; i < token_count - 1; i++) { // -1 to skip EOL
-        if (tokens[i].value) {
-            len += strlen(tokens[i].value);
+    for (const char *p = word; *p; p++) {
+        size_t ref_len = 0;
+        const char *value = (*p == '$') ? lookup_parameter(p, &ref_len, status) : NULL;
+        if (ref_len) {
+            len += strlen(value);
+            p += ref_len - 1;
         } else {
-            switch(tokens[i].type) {
-                case TOKEN_PIPE:            len += 1; break;
-                case TOKEN_REDIRECT_IN:     len += 1; break;
-                case TOKEN_REDIRECT_OUT:    len += 1; break;
-                case TOKEN_REDIRECT_APPEND: len += 2; break;
-                default: break;
-            }
+            len++;
+        }
+    }
+    char *expanded = arena_alloc(&g_line_arena, len + 1);
+    char *out = expanded;
+    for (const char *p = word; *p; p++) {
+        size_t ref_len = 0;
+        const char *value = (*p == '$') ? lookup_parameter(p, &ref_len, status) : NULL;
+        if (ref_len) {
+            size_t value_len = strlen(value);
+            memcpy(out, value, value_len);
+            out += value_len;
+            p += ref_len - 1;
+        } else {
+            *out++ = *p;
         }
-        len++; // For space
     }
+    *out = '\0';
+    return expanded;
+}
 
-    char *cmd_str = malloc(len + 1);
-    if (!cmd_str) { perror("malloc"); return NULL; }
-    cmd_str[0] = '\0';
-    bool first = true;
+// Expands 'word' with "$?" as the last exit status. Expansion happens just before
+// a command runs, so each command of an and-or list sees the status of the one
+// before it, and each iteration of a loop sees the loop variable's current value.
+static const char* expand_word(const char *word) {
+    char status[16];
+    snprintf(status, sizeof(status), "%d", g_last_status);
+    return expand_word_with_status(word, status);
+}
 
-    // Build the string by concatenating token values and operators.
-    for (int i = 0; i < token_count - 1; i++) {
-        const char* to_add = tokens[i].value; // Default to name token
-        if (!to_add) { // Handle operators
-            switch(tokens[i].type) {
-                case TOKEN_PIPE:            to_add = "|"; break;
-                case TOKEN_REDIRECT_IN:     to_add = "<"; break;
-                case TOKEN_REDIRECT_OUT:    to_add = ">"; break;
-                case TOKEN_REDIRECT_APPEND: to_add = ">>"; break;
-                default: break;
+// Copies a plan's token array into the line arena with its words expanded, "$?"
+// as 'status' (see expand_word_with_status()). The executors may modify the
+// tokens they are given, and the plan must stay intact. Words that expand to
+// nothing are dropped, so '*token_count' may shrink.
+static Token* expand_tokens_with_status(const Token *tokens, int *token_count, const char *status) {
+    Token *expanded = arena_alloc(&g_line_arena, *token_count * sizeof(Token));
+    int count = 0;
+    for (int i = 0; i < *token_count; i++) {
+        expanded[count] = tokens[i];
+        if (tokens[i].type == TOKEN_NAME) {
+            expanded[count].value = (char *)expand_word_with_status(tokens[i].value, status);
+            bool is_target = (i > 0 && tokens[i - 1].type != TOKEN_NAME);
+            if (expanded[count].value[0] == '\0' && !is_target) {
+                continue;
             }
         }
-        if (to_add) {
-            if (!first) strcat(cmd_str, " ");
-            strcat(cmd_str, to_add);
-            first = false;
+        count++;
+    }
+    *token_count = count;
+    return expanded;
+}
+
+// Expands a plan's tokens with "$?" as the last exit status.
+static Token* expand_tokens(const Token *tokens, int *token_count) {
+    char status[16];
+    snprintf(status, sizeof(status), "%d", g_last_status);
+    return expand_tokens_with_status(tokens, token_count, status);
+}
+
+// Appends 'text' to the string being built in the line arena at '*buffer'.
+static void append_queue_text(char **buffer, size_t *len, const char *text) {
+    size_t text_len = strlen(text);
+    char *grown = arena_alloc(&g_line_arena, *len + text_len + 1);
+    memcpy(grown, *buffer, *len);
+    memcpy(grown + *len, text, text_len + 1);
+    *buffer = grown;
+    *len += text_len;
+}
+
+// Appends a pipeline with its words expanded now, "$?" as 'status'. A loop is
+// kept as written, since its words depend on the loop variable.
+static void append_expanded_pipeline(char **buffer, size_t *len, const PlanPipeline *pipeline, const char *status) {
+    if (pipeline->loop) {
+        append_queue_text(buffer, len, pipeline->text);
+        return;
+    }
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        if (i > 0) append_queue_text(buffer, len, " |");
+        int token_count = pipeline->commands[i].token_count;
+        Token *tokens = expand_tokens_with_status(pipeline->commands[i].tokens, &token_count, status);
+        for (int t = 0; t < token_count - 1; t++) {
+            const char *text = tokens[t].value;
+            if (tokens[t].type == TOKEN_REDIRECT_IN) text = "<";
+            else if (tokens[t].type == TOKEN_REDIRECT_OUT) text = ">";
+            else if (tokens[t].type == TOKEN_REDIRECT_APPEND) text = ">>";
+            append_queue_text(buffer, len, " ");
+            append_queue_text(buffer, len, text);
         }
     }
-    return cmd_str;
 }
 
-// Helper to check if a command line contains 'log' as an atomic command.
-// This is used to decide whether to add the command to history.
-static bool command_contains_log_command(Token *tokens, int token_count) {
-    for (int i = 0; i < token_count - 1; i++) {
-        // We are looking for 'log' as a command name.
-        if (tokens[i].type == TOKEN_NAME && strcmp(tokens[i].value, "log") == 0) {
-            // 'log' is a command if it's the first token of the line...
-            if (i == 0) {
-                return true;
-            }
-            // ...or if it follows a command separator.
-            TokenType prev_type = tokens[i - 1].type;
-            if (prev_type == TOKEN_SEMICOLON || prev_type == TOKEN_AMPERSAND || prev_type == TOKEN_PIPE) {
-                return true;
-            }
+// With every job slot busy, a background command waits in the queue and is
+// re-run as "<command> &" once an earlier job finishes. Its words are expanded
+// now, so it uses the variables as they are when it is queued, as it would had it
+// started at once. Only "$?" after the first pipeline of an and-or list is left
+// for later, since it refers to the status of the pipeline before it.
+static void queue_for_job_slot(const PlanPipeline *pipelines, int num_pipelines, const TokenType *operators) {
+    char status[16];
+    snprintf(status, sizeof(status), "%d", g_last_status);
+    char *queued = arena_alloc(&g_line_arena, 1);
+    size_t len = 0;
+    queued[0] = '\0';
+    for (int i = 0; i < num_pipelines; i++) {
+        if (i > 0) append_queue_text(&queued, &len, operators[i - 1] == TOKEN_AND_IF ? " &&" : " ||");
+        append_expanded_pipeline(&queued, &len, &pipelines[i], i == 0 ? status : NULL);
+    }
+    append_queue_text(&queued, &len, " &");
+    queue_background_command(queued + 1); // Skip the leading space.
+}
+
+// Runs an and-or list ("a && b || c") in the foreground: each pipeline runs only
+// if the previous status calls for it ('&&' after success, '||' after failure).
+// A skipped pipeline leaves the status unchanged.
+static void run_and_or_list(const PlanAndOr *and_or, const char *home_dir) {
+    g_last_status = execute_pipeline_node(&and_or->pipelines[0], home_dir, false);
+    for (int i = 1; i < and_or->num_pipelines && g_last_status != 128 + SIGINT; i++) {
+        bool run = (and_or->operators[i - 1] == TOKEN_AND_IF) ? (g_last_status == 0) : (g_last_status != 0);
+        if (run) {
+            g_last_status = execute_pipeline_node(&and_or->pipelines[i], home_dir, false);
         }
     }
-    return false;
 }
 
-void process_command_line(const char *command, const char *home_dir, bool should_log) {
-    int token_count = 0;
-    Token *tokens = tokenize(command, &token_count);
+// Runs an and-or list in the background. The list's decisions depend on each
+// command's status, so it runs in a forked copy of the shell that executes it in
+// the foreground of its own process group; that subshell is the background job.
+static void run_and_or_list_in_background(const PlanAndOr *and_or, const char *home_dir) {
+    if (!job_slot_available()) {
+        queue_for_job_slot(and_or->pipelines, and_or->num_pipelines, and_or->operators);
+        g_last_status = 0;
+        return;
+    }
 
-    // First, do a single parse of the entire line to catch syntax errors early.
-    if (!parse_command(tokens, token_count)) {
-        add_to_history(command); // Log even invalid commands
-        printf("Invalid Syntax!\n");
-        free_tokens(tokens, token_count);
+    fflush(stdout); // Don't let the child repeat buffered output.
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        g_last_status = 1;
         return;
     }
+    if (pid == 0) {
+        // The subshell neither owns the terminal nor manages jobs of its own.
+        if (g_job_control) {
+            setpgid(0, 0);
+        }
+        g_job_control = false;
+        g_terminal_fd = -1;
+        signal(SIGINT, SIG_DFL);
+        signal(SIGQUIT, SIG_DFL);
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGTTIN, SIG_DFL);
+        signal(SIGTTOU, SIG_DFL);
+        cleanup_jobs(); // The parent's jobs and SIGCHLD pipe are not the subshell's.
+        int dev_null_fd = open("/dev/null", O_RDONLY);
+        if (dev_null_fd >= 0) {
+            dup2(dev_null_fd, STDIN_FILENO);
+            close(dev_null_fd);
+        }
 
-    // --- History Logging ---
-    // Decide whether to log this command *before* we modify the tokens for execution.
-    bool log_this_command = should_log && !command_contains_log_command(tokens, token_count);
-    if (log_this_command) {
-        char clean_command[1024];
-        strncpy(clean_command, command, sizeof(clean_command) - 1);
-        clean_command[strcspn(clean_command, "\n")] = 0; // Remove trailing newline
-        add_to_history(clean_command);
+        run_and_or_list(and_or, home_dir);
+        fflush(stdout);
+        _exit(g_last_status); // Skip the shell's atexit handlers (history, jobs).
+    }
+    if (g_job_control) {
+        setpgid(pid, pid);
     }
+    add_job(pid, &pid, 1, and_or->text);
+    g_last_status = 0;
+}
 
-    // --- D.1 & D.2: Sequential/Background Execution Splitting ---
-    // Split the command line by ';' and '&' separators.
-    int num_cmds = 1;
-    for (int i = 0; i < token_count - 1; i++) {
-        if (tokens[i].type == TOKEN_SEMICOLON || tokens[i].type == TOKEN_AMPERSAND) {
-            num_cmds++;
+// Runs a 'for' or 'while' loop. The body was compiled once; each iteration only
+// re-expands its words. Per-iteration allocations are released after every
+// iteration, so a long loop runs in constant memory.
+static int execute_loop(const PlanLoop *loop, const char *home_dir) {
+    int status = 0;
+    ArenaMark mark;
+    if (loop->is_for) {
+        int num_items = loop->num_items + 1;
+        Token *items = expand_tokens(loop->items, &num_items);
+        mark = arena_mark(&g_line_arena);
+        for (int i = 0; i < num_items - 1 && !g_interrupted; i++) {
+            set_variable(loop->variable, items[i].value);
+            execute_list(&loop->body, home_dir);
+            status = g_last_status;
+            arena_release_to(&g_line_arena, mark);
         }
+        return g_interrupted ? g_last_status : status;
     }
 
-    Token **cmds = malloc(num_cmds * sizeof(Token *));
-    int *cmd_counts = malloc(num_cmds * sizeof(int));
-    bool *cmd_is_background = malloc(num_cmds * sizeof(bool));
-    if (!cmds || !cmd_counts || !cmd_is_background) {
-        perror("malloc for sequential commands");
-        free_tokens(tokens, token_count);
-        return;
+    mark = arena_mark(&g_line_arena);
+    while (!g_interrupted) {
+        execute_list(&loop->condition, home_dir);
+        if (g_last_status != 0 || g_interrupted) {
+            break;
+        }
+        execute_list(&loop->body, home_dir);
+        status = g_last_status;
+        arena_release_to(&g_line_arena, mark);
     }
+    arena_release_to(&g_line_arena, mark);
+    return g_interrupted ? g_last_status : status;
+}
 
-    int cmd_idx = 0;
-    cmds[cmd_idx] = tokens;
-    int start_of_cmd_idx = 0;
-    for (int i = 0; i < token_count - 1; i++) {
-        TokenType type = tokens[i].type;
-        if (type == TOKEN_SEMICOLON || type == TOKEN_AMPERSAND) {
-            cmd_counts[cmd_idx] = (i - start_of_cmd_idx) + 1;
-            cmd_is_background[cmd_idx] = (type == TOKEN_AMPERSAND);
-            tokens[i].type = TOKEN_EOL; // Terminate the segment
-            cmd_idx++;
-            start_of_cmd_idx = i + 1;
-            cmds[cmd_idx] = &tokens[start_of_cmd_idx];
-        }
+// Runs the entries of a command list one after another.
+static void execute_list(const PlanList *list, const char *home_dir) {
+    for (int i = 0; i < list->num_entries && !g_interrupted; i++) {
+        execute_and_or(&list->entries[i], home_dir);
     }
-    cmd_counts[cmd_idx] = token_count - start_of_cmd_idx;
-    // The last command is not followed by a separator, so its background status
-    // is determined by whether it ends with an ampersand.
-    if (token_count > 2 && tokens[token_count - 2].type == TOKEN_AMPERSAND) {
-        cmd_is_background[cmd_idx] = true;
-        cmd_counts[cmd_idx]--; // Don't include '&' in the command's tokens
-        tokens[token_count - 2].type = TOKEN_EOL;
+}
+
+// Returns true if 'pipeline' only runs inside the shell: a loop, or 'parallel',
+// which starts and waits for its own jobs.
+static bool runs_in_shell(const PlanPipeline *pipeline) {
+    if (pipeline->loop) {
+        return true;
+    }
+    const Token *first = &pipeline->commands[0].tokens[0];
+    return pipeline->num_commands == 1 && first->type == TOKEN_NAME && strcmp(first->value, "parallel") == 0;
+}
+
+// Runs one entry of a command list: a pipeline, or an and-or list of pipelines.
+// A loop or 'parallel' sent to the background runs in a subshell, like an and-or list.
+static void execute_and_or(const PlanAndOr *and_or, const char *home_dir) {
+    if (and_or->num_pipelines == 1 && !(and_or->is_background && runs_in_shell(&and_or->pipelines[0]))) {
+        g_last_status = execute_pipeline_node(&and_or->pipelines[0], home_dir, and_or->is_background);
+    } else if (and_or->is_background) {
+        run_and_or_list_in_background(and_or, home_dir);
     } else {
-        cmd_is_background[cmd_idx] = false;
+        run_and_or_list(and_or, home_dir);
+    }
+    if (!and_or->is_background && g_last_status == 128 + SIGINT) {
+        g_interrupted = true;
+    }
+}
+
+int get_last_status(void) {
+    return g_last_status;
+}
+
+void run_queued_command_line(const char *command, const char *home_dir) {
+    int saved_status = g_last_status;
+    bool saved_interrupted = g_interrupted;
+    process_command_line(command, home_dir, false);
+    g_last_status = saved_status;
+    g_interrupted = saved_interrupted;
+}
+
+void reject_incomplete_command(void) {
+    printf("Invalid Syntax!\n");
+    g_last_status = 2;
+}
+
+void append_command_line(char **buffer, size_t *len, const char *line) {
+    size_t line_len = strcspn(line, "\n");
+    size_t start = strspn(line, " \t\r");
+    if (start >= line_len) {
+        return; // A blank line adds nothing.
+    }
+
+    // Lines are joined with "; ", unless the text so far already ends with a
+    // separator or an operator that continues onto the next line.
+    const char *separator = "; ";
+    size_t end = *len;
+    while (end > 0 && strchr(" \t\r", (*buffer)[end - 1])) {
+        end--;
+    }
+    if (end == 0) {
+        separator = "";
+    } else if (strchr(";&|", (*buffer)[end - 1])) {
+        separator = " ";
+    }
+
+    size_t separator_len = strlen(separator);
+    char *grown = realloc(*buffer, *len + separator_len + line_len + 1);
+    if (!grown) {
+        perror("realloc for command line");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(grown + *len, separator, separator_len);
+    memcpy(grown + *len + separator_len, line, line_len);
+    *len += separator_len + line_len;
+    grown[*len] = '\0';
+    *buffer = grown;
+}
+
+bool process_command_line(const char *command, const char *home_dir, bool should_log) {
+    // The plan is compiled once per distinct line and reused from the cache after
+    // that. Everything allocated while running it comes from the line arena, which
+    // the caller resets once the whole line (including nested 'log execute') is done.
+    uint64_t span = trace_begin();
+    ParseResult result;
+    ExecutionPlan *plan = plan_cache_acquire(command, &result);
+    trace_end("plan_cache_acquire", span, NULL);
+    g_interrupted = false;
+    if (result == PARSE_INCOMPLETE) {
+        trace_end("process_command_line", span, command);
+        return false; // The caller collects the rest of the loop first.
+    }
+    if (!plan) {
+        if (should_log) {
+            add_to_history(command); // Log even invalid commands
+        }
+        printf("Invalid Syntax!\n");
+        g_last_status = 2;
+        trace_end("process_command_line", span, command);
+        return true;
+    }
+
+    // --- History Logging ---
+    // Lines that run 'log' themselves are not recorded.
+    long history_entry = -1;
+    if (should_log && !plan->runs_log) {
+        // Log the whole line, however long, up to any trailing newline.
+        size_t len = strcspn(command, "\n");
+        char *clean_command = arena_alloc(&g_line_arena, len + 1);
+        memcpy(clean_command, command, len);
+        clean_command[len] = '\0';
+        add_to_history(clean_command);
+        history_entry = get_history_entry_id();
     }
 
     // --- Main Execution Loop ---
-    // Execute each command sequentially, honoring its background flag.
-    for (int i = 0; i < num_cmds; i++) {
-        execute_single_command(cmds[i], cmd_counts[i], home_dir, cmd_is_background[i]);
+    // Execute each list entry sequentially, honoring its background flag. With
+    // $MINI_SHELL_TIMING set, what the line used is kept with its history entry;
+    // background jobs it starts add theirs when they finish.
+    long outer_entry = get_usage_history_entry();
+    set_usage_history_entry(history_entry);
+    if (history_entry >= 0 && usage_tracking_enabled()) {
+        UsageTimer timer;
+        ResourceUsage usage;
+        usage_timer_start(&timer);
+        execute_list(&plan->list, home_dir);
+        usage_timer_stop(&timer, &usage);
+        add_history_usage(history_entry, &usage);
+    } else {
+        execute_list(&plan->list, home_dir);
     }
+    set_usage_history_entry(outer_entry);
+    plan_cache_release(plan);
+    trace_end("process_command_line", span, command);
+    return true;
+}
 
-    // --- Cleanup and History Logging ---
-    free(cmds);
-    free(cmd_counts);
-    free(cmd_is_background);
-    free_tokens(tokens, token_count);
+// Runs 'reveal', 'log', 'export' or 'unset' with its redirections applied in the
+// parent. This saves forking for 'reveal' and 'log', and lets 'export' and
+// 'unset' change the shell's own variables.
+static int run_builtin_with_redirects(const PlanCommand *command, const char *home_dir) {
+    // 1. Resolve the redirections; the last input and output win.
+    const char *input_file = NULL;
+    const char *output_file = NULL;
+    bool append_output = false;
+    for (int i = 0; i < command->num_redirects; i++) {
+        const char *filename = expand_word(command->redirects[i].target);
+        if (command->redirects[i].type == TOKEN_REDIRECT_IN) {
+            if (access(filename, F_OK) != 0) {
+                perror(filename);
+                return 1;
+            }
+            input_file = filename;
+        } else {
+            output_file = filename;
+            append_output = (command->redirects[i].type == TOKEN_REDIRECT_APPEND);
+        }
+    }
+    int word_count = command->word_count;
+    Token *words = expand_tokens(command->words, &word_count);
+
+    // 2. Perform redirection
+    int stdin_backup = dup(STDIN_FILENO);
+    int stdout_backup = dup(STDOUT_FILENO);
+    bool redirect_error = false;
+    int status = 1;
+
+    if (input_file) {
+        int in_fd = open(input_file, O_RDONLY);
+        if (in_fd < 0) { perror(input_file); redirect_error = true; }
+        else { dup2(in_fd, STDIN_FILENO); close(in_fd); }
+    }
+    if (output_file && !redirect_error) {
+        int flags = O_WRONLY | O_CREAT;
+        flags |= append_output ? O_APPEND : O_TRUNC;
+        int out_fd = open(output_file, flags, 0644);
+        if (out_fd < 0) { printf("Unable to create file for writing\n"); redirect_error = true; }
+        else { dup2(out_fd, STDOUT_FILENO); close(out_fd); }
+    }
+
+    // 3. Execute built-in if redirection was successful
+    if (!redirect_error) {
+        if (strcmp(words[0].value, "reveal") == 0) {
+            // Save history to disk *before* running reveal, so it can see the file.
+            // This is necessary because the main loop saves history *after* this function returns.
+            save_history();
+            status = handle_reveal(words, word_count, home_dir);
+        } else if (strcmp(words[0].value, "export") == 0) {
+            status = handle_export(words, word_count);
+        } else if (strcmp(words[0].value, "unset") == 0) {
+            status = handle_unset(words, word_count);
+        } else {
+            status = handle_log(words, word_count);
+        }
+    }
+
+    // 4. Restore I/O and clean up
+    fflush(stdout); // Flush buffer before restoring stdout
+    dup2(stdin_backup, STDIN_FILENO);
+    dup2(stdout_backup, STDOUT_FILENO);
+    close(stdin_backup);
+    close(stdout_backup);
+    return status;
 }
 
-static void execute_single_command(Token *tokens, int token_count, const char *home_dir, bool is_background) {
-    // If a segment is empty (e.g., "ls ; ; pwd"), skip it.
-    if (token_count <= 1) {
-        return;
+// Runs a command made only of NAME=value words by setting those variables in the
+// shell. Returns -1 if a command follows the assignments, so they only apply to
+// that command's environment.
+static int assign_variables(Token *tokens, int token_count) {
+    for (int i = 0; i < token_count - 1; i++) {
+        if (tokens[i].type != TOKEN_NAME || !is_assignment(tokens[i].value)) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < token_count - 1; i++) {
+        size_t name_len = variable_name_length(tokens[i].value);
+        set_variable_n(tokens[i].value, name_len, tokens[i].value + name_len + 1);
     }
+    return 0;
+}
+
+static int run_pipeline_node(const PlanPipeline *pipeline, const char *home_dir, bool is_background);
+
+// Runs one pipeline. With a 'time' prefix, what it used is reported once it is
+// done; a background pipeline is measured only with $MINI_SHELL_TIMING.
+static int execute_pipeline_node(const PlanPipeline *pipeline, const char *home_dir, bool is_background) {
+    if (!pipeline->timed || is_background) {
+        return run_pipeline_node(pipeline, home_dir, is_background);
+    }
+    UsageTimer timer;
+    usage_timer_start(&timer);
+    int status = run_pipeline_node(pipeline, home_dir, false);
+    report_usage(&timer);
+    return status;
+}
 
-    // --- Command Triage (for the current segment) ---
+static int run_pipeline_node(const PlanPipeline *pipeline, const char *home_dir, bool is_background) {
+    // --- Command Triage (for a lone command) ---
     // 1. Handle Meta-Commands and Parent-Modifying Built-ins.
     // These must run in the parent shell process and cannot be backgrounded or piped effectively.
-    if (tokens[0].type == TOKEN_NAME) {
+    if (pipeline->loop) {
+        return execute_loop(pipeline->loop, home_dir);
+    }
+    if (pipeline->num_commands == 1) {
+        const PlanCommand *command = &pipeline->commands[0];
+        int token_count = command->token_count;
+        Token *tokens = expand_tokens(command->tokens, &token_count);
+        if (tokens[0].type != TOKEN_NAME) {
+            return 0; // Every word expanded to nothing.
+        }
+
         // 'log execute' is a meta-command that re-runs a command line.
-        if (strcmp(tokens[0].value, "log") == 0 && token_count == 4 && strcmp(tokens[1].value, "execute") == 0) {
+        if (strcmp(tokens[0].value, "log") == 0 && token_count == 4 && tokens[1].type == TOKEN_NAME &&
+            strcmp(tokens[1].value, "execute") == 0 && tokens[2].type == TOKEN_NAME) {
             long index = strtol(tokens[2].value, NULL, 10);
             const char* command_to_execute = get_history_command(index);
             if (command_to_execute) {
-                process_command_line(command_to_execute, home_dir, true);
-            } else {
-                printf("log: Invalid Syntax!\n");
+                // Copy the entry: logging the re-run command may move history storage.
+                char *command_copy = arena_strdup(&g_line_arena, command_to_execute);
+                if (!process_command_line(command_copy, home_dir, true)) {
+                    reject_incomplete_command();
+                }
+                return g_last_status;
             }
-            return;
+            printf("log: Invalid Syntax!\n");
+            return 1;
         }
 
-        // These built-ins modify the parent shell's state (CWD, jobs) and must
-        // run in the foreground. If backgrounded, they fall through to be forked.
+        // These built-ins modify the parent shell's state (CWD, jobs, variables)
+        // and must run in the foreground. If backgrounded, they fall through to be forked.
         if (!is_background) {
+            if (is_assignment(tokens[0].value)) {
+                int status = assign_variables(tokens, token_count);
+                if (status >= 0) {
+                    return status;
+                }
+            }
+            if (strcmp(tokens[0].value, "export") == 0 || strcmp(tokens[0].value, "unset") == 0) {
+                return run_builtin_with_redirects(command, home_dir);
+            }
             if (strcmp(tokens[0].value, "hop") == 0 || strcmp(tokens[0].value, "cd") == 0) {
-                handle_hop(tokens, token_count, home_dir);
-                return;
+                return handle_hop(tokens, token_count, home_dir);
             }
-            if (strcmp(tokens[0].value, "log") == 0 && token_count == 3 && strcmp(tokens[1].value, "purge") == 0) {
+            if (strcmp(tokens[0].value, "log") == 0 && token_count == 3 && tokens[1].type == TOKEN_NAME &&
+                strcmp(tokens[1].value, "purge") == 0) {
                 clear_history();
-                return;
+                return 0;
             }
             if (strcmp(tokens[0].value, "fg") == 0) {
-                handle_fg(tokens, token_count);
-                return;
+                return handle_fg(tokens, token_count);
             }
             if (strcmp(tokens[0].value, "bg") == 0) {
-                handle_bg(tokens, token_count);
-                return;
+                return handle_bg(tokens, token_count);
+            }
+            if (strcmp(tokens[0].value, "parallel") == 0) {
+                return handle_parallel(tokens, token_count, home_dir);
+            }
+            if (strcmp(tokens[0].value, "jobs") == 0) {
+                return handle_jobs(tokens, token_count);
+            }
+            if (strcmp(tokens[0].value, "hash") == 0) {
+                return handle_hash(tokens, token_count);
             }
         }
 
         // Child-safe built-ins that don't modify parent state can be handled here
         // or fall through to the forking mechanism.
         if (strcmp(tokens[0].value, "activities") == 0) {
-            handle_activities();
-            return;
+            return handle_activities();
         }
         if (strcmp(tokens[0].value, "ping") == 0) {
-            handle_ping(tokens, token_count);
-            return;
+            return handle_ping(tokens, token_count);
         }
-    }
 
-    // --- Optimization for simple built-ins with redirection ---
-    // If the command is a simple built-in ('reveal' or 'log') with no pipes,
-    // we can handle its redirection in the parent process without forking.
-    int num_pipes = 0;
-    for (int i = 0; i < token_count - 1; i++) {
-        if (tokens[i].type == TOKEN_PIPE) {
-            num_pipes++;
-            break;
+        // --- Optimization for simple built-ins with redirection ---
+        // A lone 'reveal' or 'log' has its redirection handled in the parent.
+        if (strcmp(tokens[0].value, "reveal") == 0 || strcmp(tokens[0].value, "log") == 0) {
+            return run_builtin_with_redirects(command, home_dir);
         }
     }
 
-    if (num_pipes == 0 && tokens[0].type == TOKEN_NAME &&
-        (strcmp(tokens[0].value, "reveal") == 0 || strcmp(tokens[0].value, "log") == 0)) {
-        
-        // 1. Parse redirections and build a clean token list.
-        const char *input_file = NULL;
-        const char *output_file = NULL;
-        bool append_output = false;
-        
-        Token *clean_tokens = malloc(token_count * sizeof(Token));
-        if (!clean_tokens) { perror("malloc"); return; }
-        int clean_token_count = 0;
-
-        for (int i = 0; i < token_count - 1; i++) {
-            TokenType type = tokens[i].type;
-            if (type == TOKEN_REDIRECT_IN || type == TOKEN_REDIRECT_OUT || type == TOKEN_REDIRECT_APPEND) {
-                if (i + 1 < token_count - 1 && tokens[i+1].type == TOKEN_NAME) {
-                    const char* filename = tokens[i+1].value;
-                    if (type == TOKEN_REDIRECT_IN) {
-                        if (access(filename, F_OK) != 0) {
-                            perror(filename);
-                            free(clean_tokens);
-                            return;
-                        }
-                        input_file = filename;
-                    } else {
-                        output_file = filename;
-                        append_output = (type == TOKEN_REDIRECT_APPEND);
-                    }
-                    i++; // Skip filename token
-                }
-            } else {
-                clean_tokens[clean_token_count++] = tokens[i];
-            }
-        }
-        clean_tokens[clean_token_count].type = TOKEN_EOL;
-        clean_tokens[clean_token_count].value = NULL;
-        clean_token_count++;
-
-        // 2. Perform redirection
-        int stdin_backup = dup(STDIN_FILENO);
-        int stdout_backup = dup(STDOUT_FILENO);
-        bool redirect_error = false;
-
-        if (input_file) {
-            int in_fd = open(input_file, O_RDONLY);
-            if (in_fd < 0) { perror(input_file); redirect_error = true; }
-            else { dup2(in_fd, STDIN_FILENO); close(in_fd); }
-        }
-        if (output_file && !redirect_error) {
-            int flags = O_WRONLY | O_CREAT;
-            flags |= append_output ? O_APPEND : O_TRUNC;
-            int out_fd = open(output_file, flags, 0644);
-            if (out_fd < 0) { printf("Unable to create file for writing\n"); redirect_error = true; }
-            else { dup2(out_fd, STDOUT_FILENO); close(out_fd); }
-        }
-
-        // 3. Execute built-in if redirection was successful
-        if (!redirect_error) {
-            if (strcmp(tokens[0].value, "reveal") == 0) {
-                // Save history to disk *before* running reveal, so it can see the file.
-                // This is necessary because the main loop saves history *after* this function returns.
-                save_history();
-                handle_reveal(clean_tokens, clean_token_count, home_dir);
-            } else {
-                handle_log(clean_tokens, clean_token_count);
-            }
-        }
-
-        // 4. Restore I/O and clean up
-        fflush(stdout); // Flush buffer before restoring stdout
-        dup2(stdin_backup, STDIN_FILENO);
-        dup2(stdout_backup, STDOUT_FILENO);
-        close(stdin_backup);
-        close(stdout_backup);
-        free(clean_tokens);
-        return;
+    if (is_background && !job_slot_available()) {
+        queue_for_job_slot(pipeline, 1, NULL);
+        return 0;
     }
 
-    // Reconstruct the full command string for job control messages.
-    char *full_command = reconstruct_command_string(tokens, token_count);
-
-    // 2. Default: Handle as a potential pipeline.
-    int num_segments = 1;
-    for (int j = 0; j < token_count - 1; j++) {
-        if (tokens[j].type == TOKEN_PIPE) num_segments++;
-    }
-
-    Token **segments = malloc(num_segments * sizeof(Token *));
-    int *segment_counts = malloc(num_segments * sizeof(int));
-    
-    int segment_idx = 0;
-    segments[segment_idx] = tokens;
-    int start_of_segment_idx = 0;
-    for (int j = 0; j < token_count - 1; j++) {
-        if (tokens[j].type == TOKEN_PIPE) {
-            segment_counts[segment_idx] = (j - start_of_segment_idx) + 1;
-            tokens[j].type = TOKEN_EOL;
-            segment_idx++;
-            start_of_segment_idx = j + 1;
-            segments[segment_idx] = &tokens[start_of_segment_idx];
-        }
+    // 2. Default: Hand the stages to the pipeline executor.
+    uint64_t span = trace_begin();
+    Token **segments = arena_alloc(&g_line_arena, pipeline->num_commands * sizeof(Token *));
+    int *segment_counts = arena_alloc(&g_line_arena, pipeline->num_commands * sizeof(int));
+    for (int i = 0; i < pipeline->num_commands; i++) {
+        const PlanCommand *command = &pipeline->commands[i];
+        segment_counts[i] = command->token_count;
+        segments[i] = expand_tokens(command->tokens, &segment_counts[i]);
     }
-    segment_counts[segment_idx] = token_count - start_of_segment_idx;
-
-    execute_pipeline(segments, segment_counts, num_segments, home_dir, is_background, full_command);
+    trace_end("expand", span, NULL);
 
-    free(full_command);
-    free(segments);
-    free(segment_counts);
-}
\ No newline at end of file
+    return execute_pipeline(segments, segment_counts, pipeline->num_commands, home_dir, is_background, pipeline->text);
+}
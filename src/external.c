@@ -4,10 +4,32 @@
 #include <unistd.h>
 #include <sys/wait.h>
 #include <string.h>
+#include <signal.h>
+#include <spawn.h>
+#include <errno.h>
 #include "builtins.h"
 #include <fcntl.h>   // Required for open() flags
 #include "jobs.h"
 #include "job_control.h"
+#include "command_hash.h"
+#include "arena.h"
+#include "variables.h"
+#include "usage.h"
+#include "trace.h"
+
+// Exit status describing why the most recent launch failed (see launch_failure_status).
+static int g_launch_failure_status = 1;
+
+// A command segment split into its argument vector and redirections.
+typedef struct {
+    char **argv;              // NULL-terminated; strings point into the original tokens
+    int argc;
+    char **assignments;       // Leading NAME=value words, for the command's environment
+    int num_assignments;
+    const char *input_file;   // Target of '<', or NULL
+    const char *output_file;  // Target of '>' or '>>', or NULL
+    bool append_output;       // True for '>>'
+} CommandSpec;
 
 // --- Helper function for Phase 2 ---
 // This function sets up I/O redirection in the child process.
@@ -51,20 +73,19 @@ static void setup_redirections(const char *input_file, const char *output_file,
     }
 }
 
-void handle_external_command(Token *tokens, int token_count, const char *home_dir, bool is_background, const char *full_command) {
-    // --- Phase 2: Pre-processing for Redirection ---
-    const char *input_file = NULL;
-    const char *output_file = NULL;
-    bool append_output = false;
+// Splits a command segment into a clean argument vector and its redirections.
+// Returns false (after printing an error) if the segment cannot be executed.
+// On success, spec->argv is allocated from the line arena.
+static bool build_command_spec(Token *tokens, int token_count, CommandSpec *spec) {
+    spec->input_file = NULL;
+    spec->output_file = NULL;
+    spec->append_output = false;
+    spec->argc = 0;
+    spec->num_assignments = 0;
 
-    // 1. Build a clean argument vector (argv) and parse out redirections.
     // We create a new list of arguments that excludes redirection operators and filenames.
-    char **argv = malloc(token_count * sizeof(char *)); // Over-allocate for simplicity
-    if (!argv) {
-        perror("malloc");
-        return;
-    }
-    int argc = 0;
+    spec->argv = arena_alloc(&g_line_arena, token_count * sizeof(char *)); // Over-allocate for simplicity
+    spec->assignments = arena_alloc(&g_line_arena, token_count * sizeof(char *));
 
     for (int i = 0; i < token_count - 1; i++) { // Loop until EOL token
         TokenType type = tokens[i].type;
@@ -78,143 +99,333 @@ void handle_external_command(Token *tokens, int token_count, const char *home_di
                     // If any one of them fails, we stop before execution.
                     if (access(filename, F_OK) != 0) {
                         perror(filename);
-                        free(argv);
-                        return;
+                        g_launch_failure_status = 1;
+                        return false;
                     }
-                    input_file = filename;
+                    spec->input_file = filename;
                 } else { // For > or >>
-                    output_file = tokens[i + 1].value;
-                    append_output = (type == TOKEN_REDIRECT_APPEND);
+                    spec->output_file = filename;
+                    spec->append_output = (type == TOKEN_REDIRECT_APPEND);
                 }
                 i++; // Crucially, increment i again to skip the filename token.
             } else {
                 fprintf(stderr, "shell: syntax error near unexpected token\n");
-                free(argv);
-                return;
+                g_launch_failure_status = 2;
+                return false;
             }
+        } else if (spec->argc == 0 && is_assignment(tokens[i].value)) {
+            // NAME=value before the command name only sets the command's environment.
+            spec->assignments[spec->num_assignments++] = tokens[i].value;
         } else {
             // This is a regular command or argument, so add it to our clean argv.
-            argv[argc++] = tokens[i].value;
+            spec->argv[spec->argc++] = tokens[i].value;
         }
     }
-    argv[argc] = NULL; // Null-terminate the new argv for execvp.
+    spec->argv[spec->argc] = NULL; // Null-terminate the new argv for execvp.
+    return true;
+}
 
-    // If no command was found (e.g., input was just "> out.txt"), do nothing.
-    if (argc == 0) {
-        free(argv);
-        return;
+// Runs a child-safe built-in with the given argument vector and exits.
+static void run_builtin_in_child(const CommandSpec *spec, const char *home_dir) {
+    // We create a temporary token list for the handler.
+    // It has `argc` name tokens and one EOL token.
+    Token *clean_tokens = arena_alloc(&g_line_arena, (spec->argc + 1) * sizeof(Token));
+    for (int i = 0; i < spec->argc; i++) {
+        clean_tokens[i].type = TOKEN_NAME;
+        clean_tokens[i].value = spec->argv[i]; // Point to the existing string
     }
+    clean_tokens[spec->argc].type = TOKEN_EOL;
+    clean_tokens[spec->argc].value = NULL;
 
-    // 2. Fork the process.
-    pid_t pid = fork();
+    int status;
+    if (strcmp(spec->argv[0], "reveal") == 0) {
+        status = handle_reveal(clean_tokens, spec->argc + 1, home_dir);
+    } else if (strcmp(spec->argv[0], "export") == 0) {
+        // Lets 'export | grep ...' list the environment.
+        status = handle_export(clean_tokens, spec->argc + 1);
+    } else {
+        // 'log' (for printing/purging) is also a child-safe built-in.
+        status = handle_log(clean_tokens, spec->argc + 1);
+    }
+
+    exit(status);
+}
+
+// Returns true for the built-ins that run inside a forked child ('reveal', 'log',
+// 'export'). These cannot be exec'd, so they are the only commands that still need fork().
+static bool is_child_builtin(const char *name) {
+    return strcmp(name, "reveal") == 0 || strcmp(name, "log") == 0 || strcmp(name, "export") == 0;
+}
+
+// The common tail of every forked child: wires up stdin/stdout, applies redirections
+// and then runs the requested command. This function never returns.
+static void run_command_in_child(const CommandSpec *spec, const char *home_dir, int in_fd, int out_fd, bool is_background) {
+    // Pipe ends come first so that explicit redirections can override them.
+    if (in_fd >= 0) {
+        dup2(in_fd, STDIN_FILENO);
+    }
+    if (out_fd >= 0) {
+        dup2(out_fd, STDOUT_FILENO);
+    }
 
+    // Set up I/O redirections before executing the command.
+    setup_redirections(spec->input_file, spec->output_file, spec->append_output);
+
+    // --- D.2: Handle background process stdin ---
+    // If running in the background and no input redirection is specified,
+    // redirect stdin from /dev/null to prevent it from reading from the terminal.
+    if (is_background && !spec->input_file && in_fd < 0) {
+        int dev_null_fd = open("/dev/null", O_RDONLY);
+        if (dev_null_fd >= 0) {
+            dup2(dev_null_fd, STDIN_FILENO);
+            close(dev_null_fd);
+        }
+    }
+
+    for (int i = 0; i < spec->num_assignments; i++) {
+        putenv(spec->assignments[i]);
+    }
+
+    // Execute the command (either a child-safe built-in or an external program).
+    if (is_child_builtin(spec->argv[0])) {
+        run_builtin_in_child(spec, home_dir);
+    }
+
+    execvp(spec->argv[0], spec->argv);
+
+    perror(spec->argv[0]);
+    exit(EXIT_FAILURE);
+}
+
+// Launches a command with fork(). Only used for child-safe built-ins.
+// Returns the child's PID, or -1 on failure.
+static pid_t fork_command(const CommandSpec *spec, const char *home_dir, pid_t pgid, int in_fd, int out_fd, bool is_background) {
+    pid_t pid = fork();
     if (pid < 0) {
         perror("fork");
-        free(argv);
-        return;
-    } else if (pid == 0) {
-        // --- This is the Child Process ---
-
-        // E.3: Restore default signal handling.
-        // For job control, the child process needs to be in a process group.
-        // If `full_command` is not NULL, this is a simple command, so it gets its own PG.
-        // If `full_command` is NULL, it's part of a pipeline, and the pipeline executor
-        // is responsible for putting its *parent* in the correct process group.
-        if (full_command != NULL) {
-            setpgid(0, 0);
+        g_launch_failure_status = 1;
+        return -1;
+    }
+    if (pid == 0) {
+        // E.3: Join the job's process group and restore default signal handling.
+        if (g_job_control) {
+            setpgid(0, pgid);
         }
         signal(SIGINT, SIG_DFL);
         signal(SIGQUIT, SIG_DFL);
         signal(SIGTSTP, SIG_DFL);
         signal(SIGTTIN, SIG_DFL);
         signal(SIGTTOU, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
 
-        // 3. Set up I/O redirections before executing the command.
-        setup_redirections(input_file, output_file, append_output);
-
-        // --- D.2: Handle background process stdin ---
-        // If running in the background and no input redirection is specified,
-        // redirect stdin from /dev/null to prevent it from reading from the terminal.
-        if (is_background && !input_file) {
-            int dev_null_fd = open("/dev/null", O_RDONLY);
-            if (dev_null_fd >= 0) {
-                dup2(dev_null_fd, STDIN_FILENO);
-                close(dev_null_fd);
-            }
-        }
+        run_command_in_child(spec, home_dir, in_fd, out_fd, is_background);
+    }
+    // Also set the PGID from the parent so it is in place before we hand over the terminal.
+    if (g_job_control) {
+        setpgid(pid, pgid == 0 ? pid : pgid);
+    }
+    return pid;
+}
 
-        // 4. Execute the command (either a child-safe built-in or an external program).
-        if (strcmp(argv[0], "reveal") == 0) {
-            // We create a temporary token list for handle_reveal.
-            // It has `argc` name tokens and one EOL token.
-            Token *clean_tokens = malloc((argc + 1) * sizeof(Token));
-            for (int i = 0; i < argc; i++) {
-                clean_tokens[i].type = TOKEN_NAME;
-                clean_tokens[i].value = argv[i]; // Point to the existing string
-            }
-            clean_tokens[argc].type = TOKEN_EOL;
-            clean_tokens[argc].value = NULL;
+// Launches an external program with posix_spawn(), which avoids copying the shell's
+// page tables the way fork() does. Redirection targets are opened here in the parent
+// so that errors are reported exactly as before, and are handed to the child with
+// dup2 file actions. The process group and signal dispositions are set by spawn
+// attributes, so no shell code runs in the child at all.
+// Returns the child's PID, or -1 on failure.
+static pid_t spawn_command(const CommandSpec *spec, pid_t pgid, int in_fd, int out_fd, bool is_background) {
+    int redirect_in = -1;
+    int redirect_out = -1;
 
-            handle_reveal(clean_tokens, argc + 1, home_dir);
+    if (spec->input_file) {
+        redirect_in = open(spec->input_file, O_RDONLY | O_CLOEXEC);
+        if (redirect_in < 0) {
+            perror(spec->input_file);
+            g_launch_failure_status = 1;
+            return -1;
+        }
+    } else if (is_background && in_fd < 0) {
+        // --- D.2: Background jobs must not read from the terminal ---
+        redirect_in = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    }
 
-            free(clean_tokens); // Free the temporary token list wrapper
-            exit(EXIT_SUCCESS);
+    if (spec->output_file) {
+        int flags = O_WRONLY | O_CREAT | O_CLOEXEC;
+        flags |= spec->append_output ? O_APPEND : O_TRUNC;
+        redirect_out = open(spec->output_file, flags, 0644);
+        if (redirect_out < 0) {
+            printf("Unable to create file for writing\n");
+            if (redirect_in >= 0) close(redirect_in);
+            g_launch_failure_status = 1;
+            return -1;
         }
+    }
 
-        if (strcmp(argv[0], "log") == 0) {
-            // 'log' (for printing/purging) is also a child-safe built-in.
-            // We create a temporary token list for it, just like for 'reveal'.
-            Token *clean_tokens = malloc((argc + 1) * sizeof(Token));
-            for (int i = 0; i < argc; i++) {
-                clean_tokens[i].type = TOKEN_NAME;
-                clean_tokens[i].value = argv[i];
-            }
-            clean_tokens[argc].type = TOKEN_EOL;
-            clean_tokens[argc].value = NULL;
+    // Explicit redirections override pipe ends, just like in the forked path.
+    int child_in = (redirect_in >= 0) ? redirect_in : in_fd;
+    int child_out = (redirect_out >= 0) ? redirect_out : out_fd;
 
-            handle_log(clean_tokens, argc + 1);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    // dup2 clears FD_CLOEXEC on the target, while every source fd is close-on-exec.
+    if (child_in >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, child_in, STDIN_FILENO);
+    }
+    if (child_out >= 0) {
+        posix_spawn_file_actions_adddup2(&actions, child_out, STDOUT_FILENO);
+    }
 
-            free(clean_tokens);
-            exit(EXIT_SUCCESS);
+    // E.3: Put the child in the job's process group (when job control is on) and restore
+    // the signals the shell handles or ignores back to their defaults.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGINT);
+    sigaddset(&default_signals, SIGQUIT);
+    sigaddset(&default_signals, SIGTSTP);
+    sigaddset(&default_signals, SIGTTIN);
+    sigaddset(&default_signals, SIGTTOU);
+    sigaddset(&default_signals, SIGPIPE);
+    sigset_t empty_mask;
+    sigemptyset(&empty_mask);
+    posix_spawnattr_setsigdefault(&attr, &default_signals);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+    short flags = POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK;
+    if (g_job_control) {
+        posix_spawnattr_setpgroup(&attr, pgid);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    // The environment is kept ready for exec by the variable table; only a
+    // command with its own NAME=value prefixes needs a copy.
+    char **envp = spec->num_assignments
+                      ? variables_environment_with(spec->assignments, spec->num_assignments, &g_line_arena)
+                      : variables_environment();
+
+    // Resolve the program through the command hash instead of letting the
+    // C library walk $PATH with a failed execve per directory.
+    pid_t pid;
+    int err = ENOENT;
+    const char *path = hash_lookup_command(spec->argv[0]);
+    if (path) {
+        err = posix_spawn(&pid, path, &actions, &attr, spec->argv, envp);
+        // The cached file may have been moved or deleted since it was hashed.
+        if (err == ENOENT && path != spec->argv[0]) {
+            hash_forget_command(spec->argv[0]);
+            path = hash_lookup_command(spec->argv[0]);
+            if (path) {
+                err = posix_spawn(&pid, path, &actions, &attr, spec->argv, envp);
+            }
         }
-        
-        execvp(argv[0], argv);
+    }
+    if (err == ENOEXEC) {
+        // A file without a "#!" line is a shell script, as execvp() treats it.
+        char **sh_argv = arena_alloc(&g_line_arena, (spec->argc + 2) * sizeof(char *));
+        sh_argv[0] = "/bin/sh";
+        sh_argv[1] = (char *)path;
+        memcpy(sh_argv + 2, spec->argv + 1, spec->argc * sizeof(char *)); // Including the NULL
+        err = posix_spawn(&pid, "/bin/sh", &actions, &attr, sh_argv, envp);
+    }
 
-        perror(argv[0]);
-        exit(EXIT_FAILURE);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    if (redirect_in >= 0) close(redirect_in);
+    if (redirect_out >= 0) close(redirect_out);
+
+    if (err != 0) {
+        fprintf(stderr, "%s: %s\n", spec->argv[0], strerror(err));
+        // As in other shells: 127 for a command that was not found, 126 otherwise.
+        g_launch_failure_status = (err == ENOENT) ? 127 : 126;
+        return -1;
+    }
+    return pid;
+}
+
+// Launches a command using the cheapest mechanism available for it.
+static pid_t launch_command(const CommandSpec *spec, const char *home_dir, pid_t pgid, int in_fd, int out_fd, bool is_background) {
+    uint64_t span = trace_begin();
+    pid_t pid;
+    if (is_child_builtin(spec->argv[0])) {
+        pid = fork_command(spec, home_dir, pgid, in_fd, out_fd, is_background);
+        trace_end("fork", span, spec->argv[0]);
     } else {
-        // --- This is the parent process ---
-        // This parent logic distinguishes between a top-level command and one inside a pipeline.
-        if (full_command != NULL) {
-            // This is a top-level command.
-            if (is_background) {
-                // For a background job, just add it to the job list.
-                add_job(pid, argv[0]);
-            } else {
-                // For a foreground job, manage terminal control and wait.
-                pid_t pgid = pid;
-                g_foreground_pgid = pgid;
-                
-                tcsetpgrp(g_terminal_fd, pgid);
+        pid = spawn_command(spec, pgid, in_fd, out_fd, is_background);
+        trace_end("spawn", span, spec->argv[0]);
+    }
+    return pid;
+}
 
-                int status;
-                waitpid(pid, &status, WUNTRACED);
+pid_t launch_pipeline_stage(Token *tokens, int token_count, const char *home_dir, pid_t pgid, int in_fd, int out_fd, bool is_background, const char **name) {
+    CommandSpec spec;
+    if (name) {
+        *name = NULL;
+    }
+    if (!build_command_spec(tokens, token_count, &spec)) {
+        return -1;
+    }
+    if (name && spec.argc > 0) {
+        *name = spec.argv[0];
+    }
+    // An empty stage (e.g. just "> out.txt") has nothing to run.
+    pid_t pid = -1;
+    if (spec.argc > 0) {
+        pid = launch_command(&spec, home_dir, pgid, in_fd, out_fd, is_background);
+    } else {
+        g_launch_failure_status = 0;
+    }
+    return pid;
+}
 
-                tcsetpgrp(g_terminal_fd, g_shell_pgid);
-                g_foreground_pgid = 0;
+int launch_failure_status(void) {
+    return g_launch_failure_status;
+}
 
-                if (WIFSTOPPED(status)) {
-                    add_job_stopped(pid, argv[0]);
-                }
-            }
-        } else {
-            // This is an intermediate parent in a pipeline (C1, C2, C3).
-            // It must wait for its child (GC1, GC2, GC3) to finish, but does not manage jobs or terminal control.
-            int status;
-            waitpid(pid, &status, 0);
-        }
+int handle_external_command(Token *tokens, int token_count, const char *home_dir, bool is_background, const char *full_command) {
+    // --- Phase 2: Pre-processing for Redirection ---
+    // 1. Build a clean argument vector (argv) and parse out redirections.
+    CommandSpec spec;
+    if (!build_command_spec(tokens, token_count, &spec)) {
+        return g_launch_failure_status;
+    }
+
+    // If no command was found (e.g., input was just "> out.txt"), do nothing.
+    if (spec.argc == 0) {
+        return 0;
+    }
+
+    // 2. Start the command in its own process group.
+    pid_t pid = launch_command(&spec, home_dir, 0, -1, -1, is_background);
+    if (pid < 0) {
+        return g_launch_failure_status;
     }
 
-    // 6. Clean up allocated memory in the parent.
-    free(argv);
-}
\ No newline at end of file
+    // 3. Job control in the parent.
+    if (is_background) {
+        // For a background job, just add it to the job list.
+        add_job(pid, &pid, 1, spec.argv[0]);
+        return 0;
+    }
+
+    // For a foreground job, manage terminal control and wait.
+    pid_t pgid = pid;
+    g_foreground_pgid = pgid;
+
+    if (g_job_control) {
+        tcsetpgrp(g_terminal_fd, pgid);
+    }
+
+    int status;
+    wait_for_foreground(pid, &status, WUNTRACED, spec.argv[0]);
+
+    if (g_job_control) {
+        tcsetpgrp(g_terminal_fd, g_shell_pgid);
+    }
+    g_foreground_pgid = 0;
+
+    if (WIFSTOPPED(status)) {
+        add_job_stopped(pid, &pid, &status, 1, spec.argv[0]);
+    }
+    return exit_status_from_wait(status);
+}
@@ -2,13 +2,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "history_index.h"
 
 // --- Static Global Variables for History Management ---
-static char **g_history = NULL;
+// History is a circular buffer of slots. Each slot is the offset of a NUL-terminated
+// entry inside one contiguous string arena, so adding or evicting an entry is O(1)
+// and entries are not individually allocated.
+static size_t *g_history_slots = NULL;  // Ring of arena offsets, length g_history_capacity
+static int g_history_head = 0;          // Slot index of the oldest entry
 static int g_history_count = 0;
-static int g_history_capacity = 0;
-static const int MAX_HISTORY = 15;
+static int g_history_capacity = 0;      // Maximum number of entries kept (0 until first use)
+static const int DEFAULT_HISTORY_SIZE = 15;
+static const int MAX_HISTORY_SIZE = 1000000;
+// Resources used by each entry's command line, in the same slots as the ring.
+// 'measured' is false until usage is attached to the entry.
+typedef struct {
+    ResourceUsage usage;
+    bool measured;
+} HistoryUsage;
+static HistoryUsage *g_history_usage = NULL;
+static char *g_arena = NULL;            // Entry strings, appended in insertion order
+static size_t g_arena_used = 0;         // Bytes handed out from the arena
+static size_t g_arena_size = 0;         // Bytes allocated for the arena
+static size_t g_arena_live = 0;         // Bytes used by entries still in the ring
+// Sequence number of the oldest entry; each added entry gets the next number.
+// These identify entries in the search index.
+static uint32_t g_history_first_seq = 0;
 static char g_history_file_path[1024] = {0};
+// Number of the newest in-memory entries that have not been appended to the file yet.
+static int g_history_pending = 0;
+// Number of lines currently in the history file (it is an append-only journal).
+static int g_history_file_lines = 0;
+// The journal is compacted back down to the history size once it grows past this.
+static const int HISTORY_COMPACT_FACTOR = 2;
 
 // --- Private Helper Functions ---
 
@@ -17,10 +47,164 @@ static void set_history_file_path(const char *home_dir) {
     snprintf(g_history_file_path, sizeof(g_history_file_path), "%s/.mini_shell_history", home_dir);
 }
 
+// Returns the i-th entry, counting from the oldest (0) to the newest (count - 1).
+static const char* history_entry(int i) {
+    return g_arena + g_history_slots[(g_history_head + i) % g_history_capacity];
+}
+
+// Allocates the ring on first use, sized from $MINI_SHELL_HISTSIZE if it is set.
+static void ensure_history_ring(void) {
+    if (g_history_capacity > 0) {
+        return;
+    }
+    int capacity = DEFAULT_HISTORY_SIZE;
+    const char *env_size = getenv("MINI_SHELL_HISTSIZE");
+    if (env_size) {
+        long value = strtol(env_size, NULL, 10);
+        if (value >= 1 && value <= MAX_HISTORY_SIZE) {
+            capacity = (int)value;
+        }
+    }
+    g_history_slots = malloc(capacity * sizeof(size_t));
+    g_history_usage = malloc(capacity * sizeof(HistoryUsage));
+    if (!g_history_slots || !g_history_usage) {
+        perror("malloc for history");
+        exit(EXIT_FAILURE);
+    }
+    g_history_capacity = capacity;
+}
+
+// Rebuilds the arena so it holds only the live entries, in order.
+// 'min_free' is the number of bytes that must be available afterwards.
+static void compact_arena(size_t min_free) {
+    size_t new_size = (g_arena_live + min_free) * 2;
+    if (new_size < 4096) new_size = 4096;
+    char *new_arena = malloc(new_size);
+    if (!new_arena) {
+        perror("malloc for history");
+        exit(EXIT_FAILURE);
+    }
+
+    size_t offset = 0;
+    for (int i = 0; i < g_history_count; i++) {
+        int slot = (g_history_head + i) % g_history_capacity;
+        size_t len = strlen(g_arena + g_history_slots[slot]) + 1;
+        memcpy(new_arena + offset, g_arena + g_history_slots[slot], len);
+        g_history_slots[slot] = offset;
+        offset += len;
+    }
+
+    free(g_arena);
+    g_arena = new_arena;
+    g_arena_size = new_size;
+    g_arena_used = offset;
+}
+
+// Drops the oldest entry from the ring.
+static void evict_oldest(void) {
+    g_arena_live -= strlen(history_entry(0)) + 1;
+    g_history_head = (g_history_head + 1) % g_history_capacity;
+    g_history_count--;
+    g_history_first_seq++;
+}
+
+// Opens the history file and takes a write lock on it, so appends and compactions
+// by shells sharing the file do not interleave. A compaction may have renamed a
+// new file over the path while we waited, so the lock is only kept on the file
+// still at the path. If locking is unsupported, the file is used unlocked.
+// The lock is released when any fd of the file is closed. Returns -1 on error.
+static int open_locked_history_file(int flags) {
+    while (true) {
+        int fd = open(g_history_file_path, flags | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return -1;
+        }
+        struct flock lock = {.l_type = F_WRLCK, .l_whence = SEEK_SET};
+        int locked;
+        while ((locked = fcntl(fd, F_SETLKW, &lock)) < 0 && errno == EINTR) {}
+        struct stat opened, current;
+        if (locked < 0 || (fstat(fd, &opened) == 0 && stat(g_history_file_path, &current) == 0 &&
+                           opened.st_dev == current.st_dev && opened.st_ino == current.st_ino)) {
+            return fd;
+        }
+        close(fd);
+    }
+}
+
+// Rewrites the history file so it holds only its newest g_history_capacity lines.
+// The entries are taken from the file itself rather than from memory, so lines
+// appended by other shells sharing the same file are preserved: they are locked
+// out from the read until the new contents, written to a temporary file of our
+// own, are renamed over the journal.
+static void compact_history_file(void) {
+    int fd = open_locked_history_file(O_RDWR);
+    FILE *fp = (fd >= 0) ? fdopen(fd, "r") : NULL;
+    if (!fp) {
+        if (fd >= 0) close(fd);
+        return;
+    }
+
+    // Keep the last g_history_capacity lines in a circular window.
+    char **window = malloc(g_history_capacity * sizeof(char *));
+    if (!window) {
+        perror("compact_history");
+        fclose(fp);
+        return;
+    }
+    int kept = 0;
+    int next = 0;
+    char *line = NULL;
+    size_t len = 0;
+    while (getline(&line, &len, fp) != -1) {
+        line[strcspn(line, "\n")] = 0;
+        if (kept == g_history_capacity) {
+            free(window[next]);
+        } else {
+            kept++;
+        }
+        window[next] = strdup(line);
+        next = (next + 1) % g_history_capacity;
+    }
+    free(line);
+
+    char tmp_path[sizeof(g_history_file_path) + 8];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.XXXXXX", g_history_file_path);
+    int tmp_fd = mkstemp(tmp_path);
+    if (tmp_fd >= 0) {
+        fchmod(tmp_fd, 0644);
+    }
+    FILE *out = (tmp_fd >= 0) ? fdopen(tmp_fd, "w") : NULL;
+    int first = (kept == g_history_capacity) ? next : 0;
+    for (int i = 0; i < kept; i++) {
+        char *entry = window[(first + i) % g_history_capacity];
+        if (out) fprintf(out, "%s\n", entry);
+        free(entry);
+    }
+    free(window);
+    if (!out) {
+        perror("compact_history");
+        if (tmp_fd >= 0) {
+            close(tmp_fd);
+            unlink(tmp_path);
+        }
+        fclose(fp);
+        return;
+    }
+    if (fclose(out) != 0 || rename(tmp_path, g_history_file_path) != 0) {
+        perror("compact_history");
+        unlink(tmp_path);
+        fclose(fp);
+        return;
+    }
+    fclose(fp); // Releases the lock, now that the journal is the new file.
+    g_history_file_lines = kept;
+}
+
 // --- Public API Implementation ---
 
 void load_history(const char *home_dir) {
     set_history_file_path(home_dir);
+    ensure_history_ring();
     FILE *fp = fopen(g_history_file_path, "r");
     if (!fp) {
         // History file doesn't exist yet, which is fine.
@@ -29,76 +213,270 @@ void load_history(const char *home_dir) {
 
     char *line = NULL;
     size_t len = 0;
+    g_history_file_lines = 0;
     while (getline(&line, &len, fp) != -1) {
         // Remove trailing newline character
         line[strcspn(line, "\n")] = 0;
         add_to_history(line);
+        g_history_file_lines++;
     }
 
     free(line);
     fclose(fp);
+
+    // Everything loaded so far is already on disk.
+    g_history_pending = 0;
 }
 
 void save_history(void) {
     if (strlen(g_history_file_path) == 0) {
         return; // Path was never set, can't save.
     }
-    FILE *fp = fopen(g_history_file_path, "w");
-    if (!fp) {
+    if (g_history_pending == 0) {
+        return; // Nothing new since the last save.
+    }
+
+    // Gather the new entries into one buffer so they go out in a single write.
+    size_t size = 0;
+    for (int i = g_history_count - g_history_pending; i < g_history_count; i++) {
+        size += strlen(history_entry(i)) + 1;
+    }
+    char *buffer = malloc(size);
+    if (!buffer) {
         perror("save_history");
         return;
     }
+    size_t offset = 0;
+    for (int i = g_history_count - g_history_pending; i < g_history_count; i++) {
+        const char *entry = history_entry(i);
+        size_t len = strlen(entry);
+        memcpy(buffer + offset, entry, len);
+        buffer[offset + len] = '\n';
+        offset += len + 1;
+    }
 
-    for (int i = 0; i < g_history_count; i++) {
-        fprintf(fp, "%s\n", g_history[i]);
+    // O_APPEND makes each write land at the current end of the file, even when
+    // several shells share the same history file; the lock keeps the write out of
+    // another shell's compaction.
+    int fd = open_locked_history_file(O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        perror("save_history");
+        free(buffer);
+        return;
     }
+    if (write(fd, buffer, size) != (ssize_t)size) {
+        perror("save_history");
+    }
+    close(fd);
+    free(buffer);
 
-    fclose(fp);
+    g_history_file_lines += g_history_pending;
+    g_history_pending = 0;
+
+    if (g_history_file_lines > g_history_capacity * HISTORY_COMPACT_FACTOR) {
+        compact_history_file();
+    }
 }
 
 void add_to_history(const char *command) {
     if (command == NULL || strlen(command) == 0) return;
-    if (g_history_count > 0 && strcmp(command, g_history[g_history_count - 1]) == 0) return;
-
-    if (g_history_count >= MAX_HISTORY) {
-        free(g_history[0]);
-        for (int i = 0; i < g_history_count - 1; i++) {
-            g_history[i] = g_history[i + 1];
-        }
-        g_history_count--;
+    ensure_history_ring();
+    if (g_history_count > 0 && strcmp(command, history_entry(g_history_count - 1)) == 0) {
+        // Running the same line again replaces what was measured for it.
+        g_history_usage[(g_history_head + g_history_count - 1) % g_history_capacity].measured = false;
+        return;
     }
 
     if (g_history_count >= g_history_capacity) {
-        g_history_capacity = (g_history_capacity == 0) ? 8 : g_history_capacity * 2;
-        g_history = realloc(g_history, g_history_capacity * sizeof(char *));
+        evict_oldest();
+    }
+
+    // Make room in the arena. Evicted entries leave dead space behind; once it
+    // makes up most of the arena, compacting is cheaper than growing.
+    size_t len = strlen(command) + 1;
+    if (g_arena_used + len > g_arena_size) {
+        if (g_arena_live * 2 < g_arena_used) {
+            compact_arena(len);
+        } else {
+            size_t new_size = (g_arena_size == 0) ? 4096 : g_arena_size * 2;
+            while (new_size < g_arena_used + len) new_size *= 2;
+            char *grown = realloc(g_arena, new_size);
+            if (!grown) {
+                perror("realloc for history");
+                exit(EXIT_FAILURE);
+            }
+            g_arena = grown;
+            g_arena_size = new_size;
+        }
     }
 
-    g_history[g_history_count++] = strdup(command);
+    memcpy(g_arena + g_arena_used, command, len);
+    g_history_slots[(g_history_head + g_history_count) % g_history_capacity] = g_arena_used;
+    g_history_usage[(g_history_head + g_history_count) % g_history_capacity].measured = false;
+    g_arena_used += len;
+    g_arena_live += len;
+    g_history_count++;
+    history_index_add(g_history_first_seq + g_history_count - 1, command, g_history_first_seq);
+
+    // Entries evicted before they were saved are simply never written.
+    if (g_history_pending < g_history_count) {
+        g_history_pending++;
+    }
 }
 
 void print_history(void) {
     for (int i = 0; i < g_history_count; i++) {
-        printf("%s\n", g_history[i]);
+        printf("%s\n", history_entry(i));
     }
 }
 
+void print_history_usage(void) {
+    for (int i = 0; i < g_history_count; i++) {
+        const HistoryUsage *record = &g_history_usage[(g_history_head + i) % g_history_capacity];
+        if (!record->measured) {
+            printf("%s\n", history_entry(i));
+            continue;
+        }
+        char text[256];
+        format_usage(&record->usage, text, sizeof(text));
+        printf("%s  [%s]\n", history_entry(i), text);
+    }
+}
+
+long get_history_entry_id(void) {
+    if (g_history_count == 0) {
+        return -1;
+    }
+    return (long)g_history_first_seq + g_history_count - 1;
+}
+
+void add_history_usage(long entry_id, const ResourceUsage *usage) {
+    long i = entry_id - (long)g_history_first_seq;
+    if (entry_id < 0 || i < 0 || i >= g_history_count) {
+        return; // Evicted or cleared since.
+    }
+    HistoryUsage *record = &g_history_usage[(g_history_head + i) % g_history_capacity];
+    if (!record->measured) {
+        memset(&record->usage, 0, sizeof(record->usage));
+        record->measured = true;
+    }
+    add_usage(&record->usage, usage);
+}
+
 void clear_history(void) {
-    for (int i = 0; i < g_history_count; i++) free(g_history[i]);
-    free(g_history);
-    g_history = NULL;
+    history_index_clear();
+    g_history_first_seq += g_history_count;
+    free(g_arena);
+    g_arena = NULL;
+    g_arena_used = 0;
+    g_arena_size = 0;
+    g_arena_live = 0;
+    g_history_head = 0;
     g_history_count = 0;
-    g_history_capacity = 0;
+    g_history_pending = 0;
+    g_history_file_lines = 0;
     if (strlen(g_history_file_path) > 0) {
-        FILE *fp = fopen(g_history_file_path, "w");
-        if (fp) fclose(fp);
+        // Truncated under the lock, not by open(O_TRUNC), which would come before it.
+        int fd = open_locked_history_file(O_WRONLY);
+        if (fd >= 0) {
+            if (ftruncate(fd, 0) < 0) perror("log purge");
+            close(fd); // Releases the lock.
+        }
     }
 }
 
 const char* get_history_command(int index) {
     if (index < 1 || index > g_history_count) return NULL;
-    return g_history[g_history_count - index];
+    return history_entry(g_history_count - index);
+}
+
+// Prints one search hit with the index that 'log execute' accepts for it.
+static void print_search_hit(int i, const char *pattern, bool prefix_only) {
+    const char *entry = history_entry(i);
+    bool matches = prefix_only ? strncmp(entry, pattern, strlen(pattern)) == 0
+                               : strstr(entry, pattern) != NULL;
+    if (matches) {
+        printf("%5d  %s\n", g_history_count - i, entry);
+    }
+}
+
+void search_history(const char *pattern, bool prefix_only) {
+    size_t count;
+    const uint32_t *candidates = history_index_lookup(pattern, &count);
+
+    if (count == (size_t)-1) {
+        // Too short for the trigram index; scan every entry.
+        for (int i = 0; i < g_history_count; i++) {
+            print_search_hit(i, pattern, prefix_only);
+        }
+        return;
+    }
+
+    // Candidates are ascending, so hits come out oldest first like 'log'.
+    for (size_t c = 0; c < count; c++) {
+        uint32_t seq = candidates[c];
+        if (seq < g_history_first_seq) continue; // Evicted since it was indexed
+        int i = (int)(seq - g_history_first_seq);
+        if (i >= g_history_count) break;
+        print_search_hit(i, pattern, prefix_only);
+    }
 }
 
 int get_history_count(void) {
     return g_history_count;
-}
\ No newline at end of file
+}
+
+int get_history_size(void) {
+    ensure_history_ring();
+    return g_history_capacity;
+}
+
+bool set_history_size(int size) {
+    if (size < 1 || size > MAX_HISTORY_SIZE) {
+        return false;
+    }
+    ensure_history_ring();
+
+    // Keep the newest entries that still fit and lay them out from slot 0.
+    while (g_history_count > size) {
+        evict_oldest();
+    }
+    size_t *new_slots = malloc(size * sizeof(size_t));
+    HistoryUsage *new_usage = malloc(size * sizeof(HistoryUsage));
+    if (!new_slots || !new_usage) {
+        perror("malloc for history");
+        free(new_slots);
+        free(new_usage);
+        return false;
+    }
+    for (int i = 0; i < g_history_count; i++) {
+        new_slots[i] = g_history_slots[(g_history_head + i) % g_history_capacity];
+        new_usage[i] = g_history_usage[(g_history_head + i) % g_history_capacity];
+    }
+    free(g_history_slots);
+    free(g_history_usage);
+    g_history_slots = new_slots;
+    g_history_usage = new_usage;
+    g_history_head = 0;
+    g_history_capacity = size;
+    if (g_history_pending > g_history_count) {
+        g_history_pending = g_history_count;
+    }
+    return true;
+}
+
+void cleanup_history(void) {
+    history_index_clear();
+    free(g_arena);
+    free(g_history_slots);
+    free(g_history_usage);
+    g_arena = NULL;
+    g_history_slots = NULL;
+    g_history_usage = NULL;
+    g_arena_used = 0;
+    g_arena_size = 0;
+    g_arena_live = 0;
+    g_history_head = 0;
+    g_history_count = 0;
+    g_history_capacity = 0;
+}
@@ -0,0 +1,180 @@
+#include "history_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// --- Index Data Structures ---
+
+typedef struct Posting {
+    uint32_t trigram;      // The three bytes, packed into the low 24 bits
+    uint32_t *seqs;        // Ascending sequence numbers of entries containing it
+    size_t count;
+    size_t capacity;
+    struct Posting *next;  // Next posting in the same bucket
+} Posting;
+
+static Posting **g_buckets = NULL;
+static size_t g_bucket_count = 0;
+static size_t g_posting_count = 0;
+// Total sequence numbers stored, and the total at which stale ones are next pruned.
+static size_t g_total_seqs = 0;
+static size_t g_prune_threshold = 1 << 16;
+
+// --- Private Helper Functions ---
+
+static uint32_t pack_trigram(const char *p) {
+    return ((uint32_t)(unsigned char)p[0] << 16) |
+           ((uint32_t)(unsigned char)p[1] << 8) |
+           (uint32_t)(unsigned char)p[2];
+}
+
+static size_t bucket_of(uint32_t trigram, size_t bucket_count) {
+    // Multiplicative hash; bucket_count is always a power of two.
+    return (size_t)((trigram * 2654435761u) >> 8) & (bucket_count - 1);
+}
+
+static Posting* find_posting(uint32_t trigram) {
+    if (g_bucket_count == 0) return NULL;
+    for (Posting *p = g_buckets[bucket_of(trigram, g_bucket_count)]; p; p = p->next) {
+        if (p->trigram == trigram) return p;
+    }
+    return NULL;
+}
+
+// Doubles the bucket array once the table is fuller than one posting per bucket.
+static void grow_buckets(void) {
+    size_t new_count = (g_bucket_count == 0) ? 1024 : g_bucket_count * 2;
+    Posting **new_buckets = calloc(new_count, sizeof(Posting *));
+    if (!new_buckets) {
+        perror("calloc for history index");
+        exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; i < g_bucket_count; i++) {
+        Posting *p = g_buckets[i];
+        while (p) {
+            Posting *next = p->next;
+            size_t b = bucket_of(p->trigram, new_count);
+            p->next = new_buckets[b];
+            new_buckets[b] = p;
+            p = next;
+        }
+    }
+    free(g_buckets);
+    g_buckets = new_buckets;
+    g_bucket_count = new_count;
+}
+
+static Posting* find_or_add_posting(uint32_t trigram) {
+    Posting *p = find_posting(trigram);
+    if (p) return p;
+
+    if (g_posting_count >= g_bucket_count) {
+        grow_buckets();
+    }
+    p = calloc(1, sizeof(Posting));
+    if (!p) {
+        perror("calloc for history index");
+        exit(EXIT_FAILURE);
+    }
+    p->trigram = trigram;
+    size_t b = bucket_of(trigram, g_bucket_count);
+    p->next = g_buckets[b];
+    g_buckets[b] = p;
+    g_posting_count++;
+    return p;
+}
+
+// Drops sequence numbers older than 'oldest_seq'. Because every list is ascending,
+// the stale numbers are always a prefix. Postings left empty are freed.
+static void prune_stale(uint32_t oldest_seq) {
+    g_total_seqs = 0;
+    for (size_t i = 0; i < g_bucket_count; i++) {
+        Posting **link = &g_buckets[i];
+        while (*link) {
+            Posting *p = *link;
+            size_t stale = 0;
+            while (stale < p->count && p->seqs[stale] < oldest_seq) stale++;
+            if (stale == p->count) {
+                *link = p->next;
+                free(p->seqs);
+                free(p);
+                g_posting_count--;
+                continue;
+            }
+            if (stale > 0) {
+                memmove(p->seqs, p->seqs + stale, (p->count - stale) * sizeof(uint32_t));
+                p->count -= stale;
+            }
+            g_total_seqs += p->count;
+            link = &p->next;
+        }
+    }
+    // Prune again once the index has doubled, so the cost stays amortised O(1).
+    g_prune_threshold = (g_total_seqs < (1 << 15)) ? (1 << 16) : g_total_seqs * 2;
+}
+
+// --- Public API Implementation ---
+
+void history_index_add(uint32_t seq, const char *entry, uint32_t oldest_seq) {
+    size_t len = strlen(entry);
+    for (size_t i = 0; i + 3 <= len; i++) {
+        Posting *p = find_or_add_posting(pack_trigram(entry + i));
+        // A trigram repeated within one entry is only recorded once.
+        if (p->count > 0 && p->seqs[p->count - 1] == seq) continue;
+        if (p->count == p->capacity) {
+            p->capacity = (p->capacity == 0) ? 4 : p->capacity * 2;
+            uint32_t *grown = realloc(p->seqs, p->capacity * sizeof(uint32_t));
+            if (!grown) {
+                perror("realloc for history index");
+                exit(EXIT_FAILURE);
+            }
+            p->seqs = grown;
+        }
+        p->seqs[p->count++] = seq;
+        g_total_seqs++;
+    }
+
+    if (g_total_seqs > g_prune_threshold) {
+        prune_stale(oldest_seq);
+    }
+}
+
+const uint32_t* history_index_lookup(const char *pattern, size_t *count) {
+    size_t len = strlen(pattern);
+    if (len < 3) {
+        *count = (size_t)-1;
+        return NULL;
+    }
+
+    // Every match contains all of the pattern's trigrams, so the shortest
+    // posting list is a complete candidate set.
+    const Posting *best = NULL;
+    for (size_t i = 0; i + 3 <= len; i++) {
+        const Posting *p = find_posting(pack_trigram(pattern + i));
+        if (!p) {
+            *count = 0;
+            return NULL;
+        }
+        if (!best || p->count < best->count) best = p;
+    }
+    *count = best->count;
+    return best->seqs;
+}
+
+void history_index_clear(void) {
+    for (size_t i = 0; i < g_bucket_count; i++) {
+        Posting *p = g_buckets[i];
+        while (p) {
+            Posting *next = p->next;
+            free(p->seqs);
+            free(p);
+            p = next;
+        }
+    }
+    free(g_buckets);
+    g_buckets = NULL;
+    g_bucket_count = 0;
+    g_posting_count = 0;
+    g_total_seqs = 0;
+    g_prune_threshold = 1 << 16;
+}
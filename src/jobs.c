@@ -6,159 +6,445 @@
 #include <signal.h>
 #include "job_control.h"
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include "usage.h"
+#include "history.h"
 
 // --- Job Control Data Structures ---
 
-typedef struct {
-    pid_t pid;          // Process ID of the job to track
+struct BackgroundJob;
+
+// One process of a job (a pipeline has one per stage).
+typedef struct JobProcess {
+    pid_t pid;
+    int status;                 // waitpid() status once the process has exited
+    bool exited;
+    ResourceUsage usage;        // What the process used, once it has exited
+    struct BackgroundJob *job;  // The job this process belongs to
+    // Chain in the pid index. 'pid_pprev' points at the link that refers to this
+    // process (a bucket slot or the previous process's 'pid_next'), so unlinking
+    // needs no search.
+    struct JobProcess *pid_next, **pid_pprev;
+} JobProcess;
+
+// Jobs are kept in a doubly-linked list in creation order. Jobs are indexed by job
+// id and their processes by pid, so lookups, insertion and removal are all O(1).
+// The list tail is the most recently created job, which 'fg' and 'bg' use when no
+// job id is given.
+typedef struct BackgroundJob {
+    pid_t pgid;         // Process group of the job (the pid of its first process)
     int job_id;         // Job number [1], [2], etc.
     char *command_name; // The command name for reporting
     JobState state;     // The current state of the job (Running or Stopped)
+    JobProcess *procs;  // Member processes, in pipeline order
+    int num_procs;
+    int live_procs;     // Members that have not exited yet
+    struct timespec started;    // When the job was created, for its wall-clock time
+    long history_entry;         // The history entry its usage is recorded against, or -1
+    struct BackgroundJob *prev, *next; // Creation-order list
+    struct BackgroundJob *id_next, **id_pprev; // Chain in the job id index
 } BackgroundJob;
 
-static BackgroundJob *g_jobs = NULL;
+static BackgroundJob *g_jobs_head = NULL;
+static BackgroundJob *g_jobs_tail = NULL;
 static int g_job_count = 0;
-static int g_job_capacity = 0;
+static int g_live_process_count = 0;
+static JobProcess **g_procs_by_pid = NULL;
+static BackgroundJob **g_jobs_by_id = NULL;
+// Bucket count of both indexes: a power of two, grown to stay at least as large
+// as the number of indexed jobs and processes.
+static size_t g_job_buckets = 0;
 static int g_next_job_id = 1;
+// Number of jobs in the JOB_RUNNING state, checked against the job-slot limit.
+static int g_running_job_count = 0;
+// Maximum number of background jobs running at once ('jobs -j'); 0 means no limit.
+static int g_max_running_jobs = 0;
+
+// Background commands waiting for a free job slot, oldest first.
+typedef struct QueuedCommand {
+    char *command;
+    struct QueuedCommand *next;
+} QueuedCommand;
+
+static QueuedCommand *g_queue_head = NULL;
+static QueuedCommand *g_queue_tail = NULL;
+static void (*g_queue_launcher)(const char *command, void *context) = NULL;
+static void *g_queue_launcher_context = NULL;
+// Self-pipe written by the SIGCHLD handler, so child state changes can be
+// waited for with poll() alongside terminal input.
+static int g_sigchld_pipe[2] = {-1, -1};
 
 // --- Private Helper Functions ---
 
-// Finds a job by its job ID. Returns a pointer to the job or NULL if not found.
-static BackgroundJob* find_job_by_id(int job_id) {
-    for (int i = 0; i < g_job_count; i++) {
-        if (g_jobs[i].job_id == job_id) {
-            return &g_jobs[i];
+static size_t pid_bucket(pid_t pid) {
+    return ((size_t)pid * 2654435761u) & (g_job_buckets - 1);
+}
+
+static size_t id_bucket(int job_id) {
+    return (size_t)job_id & (g_job_buckets - 1); // Ids are sequential already.
+}
+
+static void index_process(JobProcess *proc) {
+    JobProcess **slot = &g_procs_by_pid[pid_bucket(proc->pid)];
+    proc->pid_next = *slot;
+    if (*slot) (*slot)->pid_pprev = &proc->pid_next;
+    proc->pid_pprev = slot;
+    *slot = proc;
+}
+
+static void unindex_process(JobProcess *proc) {
+    *proc->pid_pprev = proc->pid_next;
+    if (proc->pid_next) proc->pid_next->pid_pprev = proc->pid_pprev;
+}
+
+static void index_job(BackgroundJob *job) {
+    BackgroundJob **slot = &g_jobs_by_id[id_bucket(job->job_id)];
+    job->id_next = *slot;
+    if (*slot) (*slot)->id_pprev = &job->id_next;
+    job->id_pprev = slot;
+    *slot = job;
+}
+
+static void unindex_job(BackgroundJob *job) {
+    *job->id_pprev = job->id_next;
+    if (job->id_next) job->id_next->id_pprev = job->id_pprev;
+}
+
+// Makes sure both indexes have room for 'extra_procs' more processes and one
+// more job, doubling the bucket arrays and re-indexing everything if needed.
+// Returns false on allocation failure.
+static bool reserve_job_index(int extra_procs) {
+    size_t needed = (size_t)g_live_process_count + extra_procs;
+    if ((size_t)g_job_count + 1 > needed) needed = g_job_count + 1;
+    if (needed <= g_job_buckets) {
+        return true;
+    }
+    size_t buckets = (g_job_buckets == 0) ? 16 : g_job_buckets * 2;
+    while (buckets < needed) buckets *= 2;
+    JobProcess **by_pid = calloc(buckets, sizeof(JobProcess *));
+    BackgroundJob **by_id = calloc(buckets, sizeof(BackgroundJob *));
+    if (!by_pid || !by_id) {
+        perror("malloc for jobs");
+        free(by_pid);
+        free(by_id);
+        return false;
+    }
+    free(g_procs_by_pid);
+    free(g_jobs_by_id);
+    g_procs_by_pid = by_pid;
+    g_jobs_by_id = by_id;
+    g_job_buckets = buckets;
+    for (BackgroundJob *job = g_jobs_head; job; job = job->next) {
+        index_job(job);
+        for (int i = 0; i < job->num_procs; i++) {
+            if (!job->procs[i].exited) index_process(&job->procs[i]);
         }
     }
-    return NULL;
+    return true;
 }
 
-// Finds the most recently created job. Returns a pointer or NULL if no jobs exist.
-static BackgroundJob* find_most_recent_job(void) {
-    if (g_job_count == 0) {
+// Records that a member process has exited and drops it from the pid index.
+static void mark_process_exited(JobProcess *proc, int status, const ResourceUsage *usage) {
+    proc->exited = true;
+    proc->status = status;
+    proc->usage = *usage;
+    unindex_process(proc);
+    proc->job->live_procs--;
+    g_live_process_count--;
+}
+
+// Changes a job's state, keeping the running-job count in step.
+static void set_job_state(BackgroundJob *job, JobState state) {
+    if (job->state == JOB_RUNNING) g_running_job_count--;
+    if (state == JOB_RUNNING) g_running_job_count++;
+    job->state = state;
+}
+
+// Creates a job, appends it to the list and indexes it. Returns NULL on failure.
+// 'statuses' may be NULL; otherwise any member whose waitpid() status shows it
+// has already exited is recorded as finished.
+static BackgroundJob* create_job(pid_t pgid, const pid_t *pids, const int *statuses,
+                                 int num_pids, const char *full_command, JobState state) {
+    if (!reserve_job_index(num_pids)) {
+        return NULL;
+    }
+    BackgroundJob *job = malloc(sizeof(BackgroundJob));
+    if (!job) {
+        perror("malloc for jobs");
+        return NULL;
+    }
+    job->command_name = strdup(full_command);
+    job->procs = malloc(num_pids * sizeof(JobProcess));
+    if (!job->command_name || !job->procs) {
+        perror("malloc for jobs");
+        free(job->command_name);
+        free(job->procs);
+        free(job);
         return NULL;
     }
-    // The most recent job is the one with the highest job_id.
-    BackgroundJob *most_recent = &g_jobs[0];
-    for (int i = 1; i < g_job_count; i++) {
-        if (g_jobs[i].job_id > most_recent->job_id) {
-            most_recent = &g_jobs[i];
+    job->pgid = pgid;
+    job->job_id = g_next_job_id++;
+    job->state = state;
+    if (state == JOB_RUNNING) g_running_job_count++;
+    job->num_procs = num_pids;
+    job->live_procs = num_pids;
+    clock_gettime(CLOCK_MONOTONIC, &job->started);
+    job->history_entry = get_usage_history_entry();
+    g_live_process_count += num_pids;
+    for (int i = 0; i < num_pids; i++) {
+        job->procs[i].pid = pids[i];
+        job->procs[i].status = 0;
+        job->procs[i].exited = false;
+        job->procs[i].job = job;
+        index_process(&job->procs[i]);
+        if (statuses && (WIFEXITED(statuses[i]) || WIFSIGNALED(statuses[i]))) {
+            // Already reaped in the foreground, where its usage was counted.
+            ResourceUsage none = {0};
+            mark_process_exited(&job->procs[i], statuses[i], &none);
         }
     }
-    return most_recent;
+
+    job->prev = g_jobs_tail;
+    job->next = NULL;
+    if (g_jobs_tail) {
+        g_jobs_tail->next = job;
+    } else {
+        g_jobs_head = job;
+    }
+    g_jobs_tail = job;
+    index_job(job);
+    g_job_count++;
+    return job;
 }
 
-// Removes a job from the list by its PID.
-static void remove_job_by_pid(pid_t pid) {
-    for (int i = 0; i < g_job_count; i++) {
-        if (g_jobs[i].pid == pid) {
-            free(g_jobs[i].command_name);
-            // Shift remaining jobs down
-            for (int j = i; j < g_job_count - 1; j++) {
-                g_jobs[j] = g_jobs[j + 1];
-            }
-            g_job_count--;
-            return;
-        }
+// Unlinks a job from the list and indexes and frees it.
+static void remove_job(BackgroundJob *job) {
+    if (job->prev) job->prev->next = job->next; else g_jobs_head = job->next;
+    if (job->next) job->next->prev = job->prev; else g_jobs_tail = job->prev;
+    for (int i = 0; i < job->num_procs; i++) {
+        if (!job->procs[i].exited) unindex_process(&job->procs[i]);
+    }
+    g_live_process_count -= job->live_procs;
+    if (job->state == JOB_RUNNING) g_running_job_count--;
+    unindex_job(job);
+    g_job_count--;
+    free(job->procs);
+    free(job->command_name);
+    free(job);
+}
+
+// Sums what the job's finished processes used, with the time since it started.
+static void job_usage(const BackgroundJob *job, ResourceUsage *usage) {
+    memset(usage, 0, sizeof(*usage));
+    for (int i = 0; i < job->num_procs; i++) {
+        if (job->procs[i].exited) add_usage(usage, &job->procs[i].usage);
+    }
+    usage->real_seconds = seconds_since(&job->started);
+}
+
+// Finds a job by its job ID. Returns a pointer to the job or NULL if not found.
+static BackgroundJob* find_job_by_id(int job_id) {
+    if (g_job_count == 0) {
+        return NULL;
+    }
+    BackgroundJob *job = g_jobs_by_id[id_bucket(job_id)];
+    while (job && job->job_id != job_id) {
+        job = job->id_next;
     }
+    return job;
+}
+
+// Finds a live member process by pid. Returns a pointer to it or NULL if not found.
+static JobProcess* find_process_by_pid(pid_t pid) {
+    if (g_live_process_count == 0) {
+        return NULL;
+    }
+    JobProcess *proc = g_procs_by_pid[pid_bucket(pid)];
+    while (proc && proc->pid != pid) {
+        proc = proc->pid_next;
+    }
+    return proc;
+}
+
+// Returns the most recently created job (the current job), or NULL if no jobs exist.
+static BackgroundJob* find_most_recent_job(void) {
+    return g_jobs_tail;
+}
+
+// Starts queued commands, oldest first, while job slots are free.
+// Returns true if any were started.
+static bool start_queued_jobs(void) {
+    bool started = false;
+    while (g_queue_head && g_queue_launcher && job_slot_available()) {
+        QueuedCommand *queued = g_queue_head;
+        g_queue_head = queued->next;
+        if (!g_queue_head) g_queue_tail = NULL;
+        // A command that fails to start takes no slot, so the loop simply moves on.
+        g_queue_launcher(queued->command, g_queue_launcher_context);
+        free(queued->command);
+        free(queued);
+        started = true;
+    }
+    return started;
+}
+
+// SIGCHLD handler: just records that a child changed state. Reaping happens
+// outside the handler, in process_job_events().
+static void sigchld_handler(int sig) {
+    int saved_errno = errno;
+    // A full pipe already guarantees a pending wake-up, so errors are ignored.
+    ssize_t ignored = write(g_sigchld_pipe[1], "c", 1);
+    (void)ignored;
+    errno = saved_errno;
 }
 
 void init_jobs(void) {
-    // This function is included for good practice and future expansion.
+    if (pipe(g_sigchld_pipe) < 0) {
+        perror("pipe for SIGCHLD");
+        return;
+    }
+    for (int i = 0; i < 2; i++) {
+        fcntl(g_sigchld_pipe[i], F_SETFL, fcntl(g_sigchld_pipe[i], F_GETFL) | O_NONBLOCK);
+        fcntl(g_sigchld_pipe[i], F_SETFD, FD_CLOEXEC);
+    }
+
+    struct sigaction sa_chld = {.sa_handler = sigchld_handler, .sa_flags = SA_RESTART};
+    sigemptyset(&sa_chld.sa_mask);
+    sigaction(SIGCHLD, &sa_chld, NULL);
+}
+
+int jobs_event_fd(void) {
+    return g_sigchld_pipe[0];
 }
 
 void cleanup_jobs(void) {
-    for (int i = 0; i < g_job_count; i++) {
-        free(g_jobs[i].command_name);
+    if (g_sigchld_pipe[0] >= 0) {
+        signal(SIGCHLD, SIG_DFL);
+        close(g_sigchld_pipe[0]);
+        close(g_sigchld_pipe[1]);
+        g_sigchld_pipe[0] = g_sigchld_pipe[1] = -1;
+    }
+    while (g_jobs_head) {
+        remove_job(g_jobs_head);
     }
-    free(g_jobs);
-    g_jobs = NULL;
-    g_job_count = 0;
-    g_job_capacity = 0;
+    while (g_queue_head) {
+        QueuedCommand *next = g_queue_head->next;
+        free(g_queue_head->command);
+        free(g_queue_head);
+        g_queue_head = next;
+    }
+    g_queue_tail = NULL;
+    free(g_procs_by_pid);
+    free(g_jobs_by_id);
+    g_procs_by_pid = NULL;
+    g_jobs_by_id = NULL;
+    g_job_buckets = 0;
 }
 
-void add_job(pid_t pid, const char *full_command) {
-    // Expand the job list if necessary
-    if (g_job_count >= g_job_capacity) {
-        g_job_capacity = (g_job_capacity == 0) ? 8 : g_job_capacity * 2;
-        g_jobs = realloc(g_jobs, g_job_capacity * sizeof(BackgroundJob));
-        if (!g_jobs) {
-            perror("realloc for jobs");
-            return;
-        }
+void add_job(pid_t pgid, const pid_t *pids, int num_pids, const char *full_command) {
+    // New jobs are always running initially.
+    BackgroundJob *job = create_job(pgid, pids, NULL, num_pids, full_command, JOB_RUNNING);
+    if (!job) {
+        return;
     }
 
-    // Add the new job
-    int index = g_job_count;
-    g_jobs[index].pid = pid;
-    g_jobs[index].job_id = g_next_job_id++;
-    g_jobs[index].command_name = strdup(full_command);
-    g_jobs[index].state = JOB_RUNNING; // New jobs are always running initially.
-    g_job_count++;
-
     // Print the required message: [job_number] process_id
-    printf("[%d] %d\n", g_jobs[index].job_id, g_jobs[index].pid);
+    printf("[%d] %d\n", job->job_id, job->pgid);
 }
 
-void add_job_stopped(pid_t pid, const char *full_command) {
-    // Expand the job list if necessary
-    if (g_job_count >= g_job_capacity) {
-        g_job_capacity = (g_job_capacity == 0) ? 8 : g_job_capacity * 2;
-        g_jobs = realloc(g_jobs, g_job_capacity * sizeof(BackgroundJob));
-        if (!g_jobs) {
-            perror("realloc for jobs");
-            return;
-        }
+void add_job_stopped(pid_t pgid, const pid_t *pids, const int *statuses, int num_pids,
+                     const char *full_command) {
+    BackgroundJob *job = create_job(pgid, pids, statuses, num_pids, full_command, JOB_STOPPED);
+    if (!job) {
+        return;
     }
 
-    // Add the new job with state "Stopped"
-    int index = g_job_count;
-    g_jobs[index].pid = pid;
-    g_jobs[index].job_id = g_next_job_id++;
-    g_jobs[index].command_name = strdup(full_command);
-    g_jobs[index].state = JOB_STOPPED;
-    g_job_count++;
-
-    printf("\n[%d] Stopped %s\n", g_jobs[index].job_id, g_jobs[index].command_name);
+    printf("\n[%d] Stopped %s\n", job->job_id, job->command_name);
 }
 
-void check_background_jobs(void) {
+// Reaps every child that changed state and reports finished jobs.
+// If 'newline_first' is set, a newline is printed before the first report so it
+// does not run into a prompt that is already on screen.
+// Returns true if anything was printed.
+static bool reap_children(bool newline_first) {
     int status;
     pid_t reaped_pid;
+    ResourceUsage usage;
+    bool printed = false;
 
     // Loop and reap ANY terminated child process without blocking.
     // waitpid with -1 waits for any child process.
     // WNOHANG makes the call non-blocking.
     // WUNTRACED reports on stopped children, and WCONTINUED on continued children.
-    while ((reaped_pid = waitpid(-1, &status, WNOHANG | WUNTRACED | WCONTINUED)) > 0) {
+    while ((reaped_pid = wait_with_usage(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0) {
         // Check if this reaped PID belongs to a job we are explicitly tracking.
-        for (int i = 0; i < g_job_count; i++) {
-            if (g_jobs[i].pid == reaped_pid) {
-                if (WIFEXITED(status) || WIFSIGNALED(status)) { // Job has terminated
-                    // A job exits "normally" if it calls exit() with a status of 0 (EXIT_SUCCESS).
-                    // Any other case (non-zero exit status or termination by signal) is abnormal.
-                    if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS) {
-                        printf("%s with pid %d exited normally\n", g_jobs[i].command_name, reaped_pid);
-                    } else {
-                        printf("%s with pid %d exited abnormally\n", g_jobs[i].command_name, reaped_pid);
-                    }
-                    // Remove the job from our list.
-                    free(g_jobs[i].command_name);
-                    for (int j = i; j < g_job_count - 1; j++) g_jobs[j] = g_jobs[j + 1];
-                    g_job_count--;
-                    break; // Found the job, no need to search further.
-                } else if (WIFSTOPPED(status)) { // Job has been stopped
-                    g_jobs[i].state = JOB_STOPPED;
-                    // We don't print a message, but 'activities' will show the new state.
-                    break;
-                } else if (WIFCONTINUED(status)) { // Job has been continued
-                    g_jobs[i].state = JOB_RUNNING;
-                    // We don't print a message, but 'activities' will show the new state.
-                    break;
-                }
+        JobProcess *proc = find_process_by_pid(reaped_pid);
+        if (!proc) {
+            continue;
+        }
+        BackgroundJob *job = proc->job;
+        if (WIFEXITED(status) || WIFSIGNALED(status)) { // A member has terminated
+            mark_process_exited(proc, status, &usage);
+            if (job->live_procs > 0) {
+                continue; // The job finishes when its last member does.
+            }
+            // The job's status is that of its last process, as for a pipeline.
+            // A job exits "normally" if it calls exit() with a status of 0 (EXIT_SUCCESS).
+            // Any other case (non-zero exit status or termination by signal) is abnormal.
+            int job_status = job->procs[job->num_procs - 1].status;
+            if (newline_first && !printed) {
+                printf("\n");
             }
+            printed = true;
+            const char *how = (WIFEXITED(job_status) && WEXITSTATUS(job_status) == EXIT_SUCCESS)
+                              ? "normally" : "abnormally";
+            if (usage_tracking_enabled()) {
+                ResourceUsage total;
+                char text[256];
+                job_usage(job, &total);
+                format_usage(&total, text, sizeof(text));
+                printf("%s with pid %d exited %s [%s]\n", job->command_name, job->pgid, how, text);
+                add_history_usage(job->history_entry, &total);
+            } else {
+                printf("%s with pid %d exited %s\n", job->command_name, job->pgid, how);
+            }
+            remove_job(job);
+        } else if (WIFSTOPPED(status)) { // Job has been stopped
+            set_job_state(job, JOB_STOPPED);
+            // We don't print a message, but 'activities' will show the new state.
+        } else if (WIFCONTINUED(status)) { // Job has been continued
+            set_job_state(job, JOB_RUNNING);
         }
     }
+
+    // Finished or stopped jobs may have freed slots for queued commands.
+    if (g_queue_head && job_slot_available()) {
+        if (newline_first && !printed) {
+            printf("\n");
+        }
+        printed |= start_queued_jobs();
+    }
+    return printed;
+}
+
+void check_background_jobs(void) {
+    reap_children(false);
+}
+
+bool process_job_events(bool at_prompt) {
+    if (g_sigchld_pipe[0] < 0) {
+        // No event pipe: fall back to polling.
+        return reap_children(at_prompt);
+    }
+    char drain[64];
+    bool signalled = false;
+    while (read(g_sigchld_pipe[0], drain, sizeof(drain)) > 0) {
+        signalled = true;
+    }
+    return signalled && reap_children(at_prompt);
 }
 
 // Comparison function for qsort to sort jobs by command name.
@@ -182,30 +468,128 @@ void list_activities(void) {
         perror("malloc for activities");
         return;
     }
-    for (int i = 0; i < g_job_count; i++) {
-        sorted_jobs[i] = &g_jobs[i];
+    int n = 0;
+    for (BackgroundJob *job = g_jobs_head; job; job = job->next) {
+        sorted_jobs[n++] = job;
     }
 
     // Sort the temporary array by command name.
     qsort(sorted_jobs, g_job_count, sizeof(BackgroundJob *), compare_jobs);
 
     // Print the sorted list in the format: [pid] : command_name - State
+    // With $MINI_SHELL_TIMING set, each job's usage so far follows: its running
+    // time and what its finished processes used.
+    bool show_usage = usage_tracking_enabled();
     for (int i = 0; i < g_job_count; i++) {
         const char *state_str = (sorted_jobs[i]->state == JOB_RUNNING) ? "Running" : "Stopped";
-        printf("[%d] : %s - %s\n", sorted_jobs[i]->pid, sorted_jobs[i]->command_name, state_str);
+        if (show_usage) {
+            ResourceUsage usage;
+            char text[256];
+            job_usage(sorted_jobs[i], &usage);
+            format_usage(&usage, text, sizeof(text));
+            printf("[%d] : %s - %s [%s]\n", sorted_jobs[i]->pgid, sorted_jobs[i]->command_name, state_str, text);
+        } else {
+            printf("[%d] : %s - %s\n", sorted_jobs[i]->pgid, sorted_jobs[i]->command_name, state_str);
+        }
     }
 
     free(sorted_jobs);
 }
 
+void list_queued_jobs(void) {
+    for (QueuedCommand *queued = g_queue_head; queued; queued = queued->next) {
+        printf("[queued] : %s\n", queued->command);
+    }
+}
+
+bool job_slot_available(void) {
+    return g_max_running_jobs == 0 || g_running_job_count < g_max_running_jobs;
+}
+
+int get_max_running_jobs(void) {
+    return g_max_running_jobs;
+}
+
+void set_max_running_jobs(int limit) {
+    g_max_running_jobs = limit;
+    // A higher limit may let queued commands start right away.
+    start_queued_jobs();
+}
+
+void set_queued_job_launcher(void (*launcher)(const char *command, void *context), void *context) {
+    g_queue_launcher = launcher;
+    g_queue_launcher_context = context;
+}
+
+void queue_background_command(const char *command) {
+    QueuedCommand *queued = malloc(sizeof(QueuedCommand));
+    if (!queued || !(queued->command = strdup(command))) {
+        perror("malloc for job queue");
+        free(queued);
+        return;
+    }
+    queued->next = NULL;
+    if (g_queue_tail) {
+        g_queue_tail->next = queued;
+    } else {
+        g_queue_head = queued;
+    }
+    g_queue_tail = queued;
+    printf("[queued] %s\n", command);
+}
+
+void wait_for_queued_jobs(void) {
+    start_queued_jobs();
+    while (g_queue_head && g_sigchld_pipe[0] >= 0) {
+        // Every slot is busy: sleep until a child changes state, then reap it,
+        // which starts the next queued commands.
+        struct pollfd pfd = {.fd = g_sigchld_pipe[0], .events = POLLIN};
+        if (poll(&pfd, 1, -1) < 0 && errno != EINTR) {
+            perror("poll");
+            return;
+        }
+        process_job_events(false);
+    }
+}
+
+int exit_status_from_wait(int status) {
+    if (WIFEXITED(status)) {
+        return WEXITSTATUS(status);
+    }
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    if (WIFSTOPPED(status)) {
+        return 128 + WSTOPSIG(status);
+    }
+    return 0;
+}
+
 void kill_all_jobs(void) {
-    for (int i = 0; i < g_job_count; i++) {
-        // Send SIGKILL (9) which cannot be caught or ignored.
-        kill(g_jobs[i].pid, SIGKILL);
+    for (BackgroundJob *job = g_jobs_head; job; job = job->next) {
+        for (int i = 0; i < job->num_procs; i++) {
+            // Send SIGKILL (9) which cannot be caught or ignored.
+            if (!job->procs[i].exited) kill(job->procs[i].pid, SIGKILL);
+        }
     }
 }
 
-void continue_job_in_foreground(int job_id, bool use_default_job) {
+// Sends SIGCONT to the job's process group. Without job control (in a script)
+// the job has no group of its own, so each member still running is continued by
+// pid instead. Returns -1 if the signal could not be sent.
+static int continue_job(const BackgroundJob *job) {
+    if (g_job_control) {
+        return kill(-job->pgid, SIGCONT);
+    }
+    for (int i = 0; i < job->num_procs; i++) {
+        if (!job->procs[i].exited && kill(job->procs[i].pid, SIGCONT) < 0 && errno != ESRCH) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int continue_job_in_foreground(int job_id, bool use_default_job) {
     BackgroundJob *job;
     if (use_default_job) {
         job = find_most_recent_job();
@@ -215,46 +599,74 @@ void continue_job_in_foreground(int job_id, bool use_default_job) {
 
     if (!job) {
         printf("No such job\n");
-        return;
+        return 1;
     }
 
     // Print the command being brought to the foreground.
     printf("%s\n", job->command_name);
 
-    // Continue the job by sending SIGCONT to its process group.
-    if (kill(-job->pid, SIGCONT) < 0) {
+    if (continue_job(job) < 0) {
         perror("kill (SIGCONT)");
-        return;
+        return 1;
     }
 
     // Give terminal control to the job.
-    tcsetpgrp(g_terminal_fd, job->pid);
-    g_foreground_pgid = job->pid;
-
-    // Remove the job from background list since it's now in the foreground.
-    pid_t pid = job->pid;
-    char* command_name = strdup(job->command_name);
-    remove_job_by_pid(pid);
-
-    // Wait for the job to complete or stop again.
-    int status;
-    if (waitpid(pid, &status, WUNTRACED) < 0) {
-        perror("waitpid");
+    if (g_job_control) {
+        tcsetpgrp(g_terminal_fd, job->pgid);
+    }
+    g_foreground_pgid = job->pgid;
+
+    // Take the job out of the background list since it's now in the foreground,
+    // keeping what is needed to put it back if it stops again.
+    pid_t pgid = job->pgid;
+    int num_procs = job->num_procs;
+    char *command_name = strdup(job->command_name);
+    pid_t *pids = malloc(num_procs * sizeof(pid_t));
+    int *statuses = malloc(num_procs * sizeof(int));
+    if (!command_name || !pids || !statuses) {
+        perror("malloc for fg");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < num_procs; i++) {
+        pids[i] = job->procs[i].pid;
+        statuses[i] = job->procs[i].status;
+        if (!job->procs[i].exited) statuses[i] = -1; // Still to be waited for
+    }
+    remove_job(job);
+
+    // Wait for every remaining member to complete or stop again.
+    bool job_stopped = false;
+    for (int i = 0; i < num_procs; i++) {
+        if (statuses[i] != -1) continue;
+        if (wait_for_foreground(pids[i], &statuses[i], WUNTRACED, NULL) < 0) {
+            perror("waitpid");
+            statuses[i] = 0;
+        }
+        if (WIFSTOPPED(statuses[i])) {
+            job_stopped = true;
+        }
     }
 
     // Take back terminal control.
-    tcsetpgrp(g_terminal_fd, g_shell_pgid);
+    if (g_job_control) {
+        tcsetpgrp(g_terminal_fd, g_shell_pgid);
+    }
     g_foreground_pgid = 0;
 
     // If the job was stopped again, add it back to the list.
-    if (WIFSTOPPED(status)) {
-        add_job_stopped(pid, command_name);
+    if (job_stopped) {
+        add_job_stopped(pgid, pids, statuses, num_procs, command_name);
     }
-    
+
+    // Like a pipeline, the job's status is that of its last process.
+    int exit_status = exit_status_from_wait(statuses[num_procs - 1]);
+    free(pids);
+    free(statuses);
     free(command_name);
+    return exit_status;
 }
 
-void continue_job_in_background(int job_id, bool use_default_job) {
+int continue_job_in_background(int job_id, bool use_default_job) {
     BackgroundJob *job;
     if (use_default_job) {
         job = find_most_recent_job();
@@ -264,23 +676,23 @@ void continue_job_in_background(int job_id, bool use_default_job) {
 
     if (!job) {
         printf("No such job\n");
-        return;
+        return 1;
     }
 
     if (job->state == JOB_RUNNING) {
         printf("Job already running\n");
-        return;
+        return 0;
     }
 
     // Print the command being resumed in the background.
     printf("[%d] %s &\n", job->job_id, job->command_name);
 
-    // Continue the job by sending SIGCONT.
-    if (kill(-job->pid, SIGCONT) < 0) {
+    if (continue_job(job) < 0) {
         perror("kill (SIGCONT)");
-        return;
+        return 1;
     }
 
     // Update the job's state.
-    job->state = JOB_RUNNING;
+    set_job_state(job, JOB_RUNNING);
+    return 0;
 }
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "line_reader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+
+#define LINE_READER_CHUNK (64 * 1024)
+
+// --- Private Helper Functions ---
+
+// Makes room for at least one more chunk after 'end'. Already-returned bytes are
+// discarded first; the buffer only grows when a single line fills it.
+static void make_room(LineReader *reader, size_t *scan_from) {
+    if (reader->start > 0) {
+        memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+        reader->end -= reader->start;
+        *scan_from -= reader->start;
+        reader->start = 0;
+    }
+    // Keep one spare byte for the NUL of an unterminated final line.
+    if (reader->capacity - reader->end < LINE_READER_CHUNK + 1) {
+        size_t new_capacity = reader->capacity ? reader->capacity * 2 : LINE_READER_CHUNK * 2;
+        while (new_capacity - reader->end < LINE_READER_CHUNK + 1) new_capacity *= 2;
+        char *grown = realloc(reader->buffer, new_capacity);
+        if (!grown) {
+            perror("realloc for line reader");
+            exit(EXIT_FAILURE);
+        }
+        reader->buffer = grown;
+        reader->capacity = new_capacity;
+    }
+}
+
+// Blocks until the reader's fd has data, running the event callbacks each time
+// one of the event fds becomes readable in the meantime.
+static void wait_for_input(LineReader *reader) {
+    if (reader->num_events == 0) {
+        return;
+    }
+    struct pollfd fds[LINE_READER_MAX_EVENTS + 1];
+    fds[0].fd = reader->fd;
+    fds[0].events = POLLIN;
+    for (int i = 0; i < reader->num_events; i++) {
+        fds[i + 1].fd = reader->events[i].fd;
+        fds[i + 1].events = POLLIN;
+    }
+    while (true) {
+        if (poll(fds, reader->num_events + 1, -1) < 0) {
+            if (errno == EINTR) continue;
+            return; // Let read() report the problem.
+        }
+        for (int i = 0; i < reader->num_events; i++) {
+            if (fds[i + 1].revents & POLLIN) {
+                reader->events[i].on_event(reader->events[i].context);
+            }
+        }
+        if (fds[0].revents) {
+            return;
+        }
+    }
+}
+
+// --- Public API Implementation ---
+
+void line_reader_init(LineReader *reader, int fd) {
+    reader->fd = fd;
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = false;
+    reader->continuation_prompt = NULL;
+    reader->continuing = false;
+    reader->num_events = 0;
+}
+
+bool line_reader_add_event(LineReader *reader, int fd, void (*on_event)(void *context), void *context) {
+    if (fd < 0 || reader->num_events == LINE_READER_MAX_EVENTS) {
+        return false;
+    }
+    LineReaderEvent *event = &reader->events[reader->num_events++];
+    event->fd = fd;
+    event->on_event = on_event;
+    event->context = context;
+    return true;
+}
+
+void line_reader_free(LineReader *reader) {
+    free(reader->buffer);
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    reader->start = 0;
+    reader->end = 0;
+}
+
+void line_reader_take_buffered(LineReader *reader, LineReader *source) {
+    size_t len = source->end - source->start;
+    if (len == 0) {
+        return;
+    }
+    reader->buffer = malloc(len + 1);
+    if (!reader->buffer) {
+        perror("malloc for line reader");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(reader->buffer, source->buffer + source->start, len);
+    reader->capacity = len + 1;
+    reader->end = len;
+    source->start = source->end;
+}
+
+char* line_reader_next(LineReader *reader, size_t *length) {
+    size_t scan_from = reader->start;
+    reader->continuing = false;
+
+    while (true) {
+        char *newline = NULL;
+        if (reader->end > scan_from) {
+            newline = memchr(reader->buffer + scan_from, '\n', reader->end - scan_from);
+        }
+
+        if (newline) {
+            size_t line_end = newline - reader->buffer;
+            // "\<newline>" continues the line: drop both characters and keep scanning.
+            if (line_end > reader->start && reader->buffer[line_end - 1] == '\\') {
+                memmove(reader->buffer + line_end - 1, reader->buffer + line_end + 1,
+                        reader->end - line_end - 1);
+                reader->end -= 2;
+                scan_from = line_end - 1;
+                reader->continuing = true;
+                continue;
+            }
+            reader->buffer[line_end] = '\0';
+            reader->continuing = false;
+            char *line = reader->buffer + reader->start;
+            if (length) *length = line_end - reader->start;
+            reader->start = line_end + 1;
+            return line;
+        }
+
+        if (reader->eof) {
+            if (reader->start == reader->end) {
+                return NULL;
+            }
+            // The input ended without a newline; return what is left as the last line.
+            size_t line_end = reader->end;
+            if (reader->buffer[line_end - 1] == '\\') line_end--;
+            reader->buffer[line_end] = '\0';
+            reader->continuing = false;
+            char *line = reader->buffer + reader->start;
+            if (length) *length = line_end - reader->start;
+            reader->start = reader->end;
+            return line;
+        }
+
+        // No complete line buffered yet: read another chunk.
+        scan_from = reader->end;
+        make_room(reader, &scan_from);
+        if (reader->continuing && reader->continuation_prompt) {
+            printf("%s", reader->continuation_prompt);
+            fflush(stdout);
+        }
+        wait_for_input(reader);
+        ssize_t n = read(reader->fd, reader->buffer + reader->end,
+                         reader->capacity - reader->end - 1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("read");
+            reader->eof = true;
+        } else if (n == 0) {
+            reader->eof = true;
+        } else {
+            reader->end += n;
+        }
+    }
+}
@@ -3,16 +3,28 @@
 #include<stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <time.h>
 #include "prompt.h"
+#include "prompt_segments.h"
+#include "usage.h"
+#include "trace.h"
 #include "history.h"
 #include "command_processor.h"
+#include "plan_cache.h"
+#include "variables.h"
 #include "jobs.h"
 #include "job_control.h"
+#include "command_hash.h"
+#include "script.h"
+#include "arena.h"
+#include "line_reader.h"
+#include "parallel.h"
 
 // --- Global variables for job control ---
 int g_terminal_fd;
 pid_t g_shell_pgid;
 volatile pid_t g_foreground_pgid = 0;
+bool g_job_control = false;
 
 // --- Signal Handlers ---
 
@@ -31,15 +43,101 @@ static void sigtstp_handler(int sig) {
     }
 }
 
-int main() {
+// Stats hook enabled by $MINI_SHELL_ARENA_STATS: reports per-line arena usage.
+static void print_arena_stats(const ArenaStats *stats) {
+    fprintf(stderr, "[arena] %zu bytes in %zu allocations (%zu reserved)\n",
+            stats->bytes, stats->allocations, stats->reserved);
+}
+
+// A loop typed over several lines is collected here until it is complete.
+static char *g_pending_command = NULL;
+static size_t g_pending_len = 0;
+
+// Called by the line reader whenever a child changes state while we wait for input,
+// so finished background jobs are reaped and reported immediately.
+static void on_job_event(void *context) {
+    if (process_job_events(true)) {
+        // Redraw the prompt under the reports.
+        if (g_pending_command) {
+            printf("> ");
+            fflush(stdout);
+        } else {
+            display_prompt();
+        }
+    }
+}
+
+// Called by the line reader when the prompt segment worker has new values. The
+// prompt is only redrawn while it is the last thing on screen.
+static void on_prompt_segment_event(void *context) {
+    const LineReader *reader = context;
+    if (!g_pending_command && !reader->continuing) {
+        prompt_segments_updated();
+    } else {
+        process_prompt_segment_events(); // Not at the main prompt; shown next time.
+    }
+}
+
+// Starts a background command that was queued for a free job slot.
+static void launch_queued_job(const char *command, void *home_dir) {
+    run_queued_command_line(command, home_dir);
+}
+
+// Runs a script file or a '-c' command string. Scripts are not interactive:
+// there is no prompt, no history file I/O and no job control, so commands stay in
+// the shell's own process group and receive terminal signals along with it.
+static int run_non_interactive(int argc, char *argv[], const char *home_dir) {
+    g_terminal_fd = -1;
+    // Output usually goes to a pipe or file, where stdout would be fully buffered
+    // and the shell's own lines would come out after those of later commands.
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    init_jobs();
+    atexit(cleanup_jobs);
+    atexit(cleanup_command_hash);
+    atexit(cleanup_line_arena);
+    atexit(cleanup_plan_cache);
+    atexit(cleanup_variables);
+    set_queued_job_launcher(launch_queued_job, (void *)home_dir);
+
+    int status;
+    if (strcmp(argv[1], "-c") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "%s: -c: option requires an argument\n", argv[0]);
+            return 2;
+        }
+        status = run_script_string(argv[2], home_dir);
+    } else {
+        status = run_script_file(argv[1], home_dir);
+    }
+    // Commands still waiting for a job slot are started before the shell exits.
+    wait_for_queued_jobs();
+    return status;
+}
+
+int main(int argc, char *argv[]) {
     char home_dir[1024];
     if (getcwd(home_dir, sizeof(home_dir)) == NULL) {
         perror("getcwd");
         return 1;
     }
 
+    init_variables();
+    init_trace();
+    atexit(cleanup_trace); // Registered first so it runs last, after every other span.
+
+    if (getenv("MINI_SHELL_ARENA_STATS")) {
+        line_arena_set_stats_hook(print_arena_stats);
+    }
+
+    // 'shell.out script.sh' and 'shell.out -c "..."' run without the interactive loop.
+    if (argc > 1) {
+        return run_non_interactive(argc, argv, home_dir);
+    }
+
     // --- E.3: Initialization for Job Control ---
     g_terminal_fd = STDIN_FILENO;
+    g_job_control = true;
     // Check if we are running in an interactive terminal.
     if (isatty(g_terminal_fd)) {
         // Loop until we are in the foreground.
@@ -77,26 +175,67 @@ int main() {
     }
 
     init_jobs();
+    init_prompt(home_dir);
+    init_prompt_segments();
+    set_queued_job_launcher(launch_queued_job, home_dir);
     load_history(home_dir);
+    atexit(cleanup_history); // Registered first so it runs after save_history.
     atexit(save_history);
     atexit(cleanup_jobs);
+    atexit(cleanup_command_hash);
+    atexit(cleanup_line_arena);
+    atexit(cleanup_plan_cache);
+    atexit(cleanup_variables);
+    atexit(cleanup_prompt);
+    atexit(cleanup_prompt_segments);
+
+    // Lines of any length are read straight from the stdin fd; a trailing
+    // backslash continues the command on the next line.
+    LineReader reader;
+    line_reader_init(&reader, STDIN_FILENO);
+    reader.continuation_prompt = "> ";
+    line_reader_add_event(&reader, jobs_event_fd(), on_job_event, NULL);
+    line_reader_add_event(&reader, prompt_segments_event_fd(), on_prompt_segment_event, &reader);
+    set_parallel_stdin_reader(&reader);
 
     while (1) {
-        display_prompt(home_dir);
+        if (g_pending_command) {
+            printf("> "); // The loop being typed continues on this line.
+            fflush(stdout);
+        } else {
+            display_prompt();
+        }
 
-        char input_buffer[1024];
-        
-        if (fgets(input_buffer, sizeof(input_buffer), stdin) == NULL) {
+        char *line = line_reader_next(&reader, NULL);
+        if (line == NULL) {
             // E.3: Handle Ctrl-D (EOF)
             kill_all_jobs();
             printf("logout\n");
             break;
         }
 
-        check_background_jobs();
+        process_job_events(false);
 
-        process_command_line(input_buffer, home_dir, true);
+        struct timespec started;
+        clock_gettime(CLOCK_MONOTONIC, &started);
+        if (g_pending_command) {
+            append_command_line(&g_pending_command, &g_pending_len, line);
+            if (process_command_line(g_pending_command, home_dir, true)) {
+                free(g_pending_command);
+                g_pending_command = NULL;
+                g_pending_len = 0;
+                prompt_segments_set_duration(seconds_since(&started));
+            }
+        } else if (process_command_line(line, home_dir, true)) {
+            prompt_segments_set_duration(seconds_since(&started));
+        } else {
+            append_command_line(&g_pending_command, &g_pending_len, line);
+        }
+        line_arena_finish();
         save_history(); // Save history after each command
+        trace_flush();
     }
+    free(g_pending_command);
+    line_reader_free(&reader);
     return 0;
 }
\ No newline at end of file
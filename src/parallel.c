@@ -0,0 +1,305 @@
+#include "parallel.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include "external.h"
+#include "jobs.h"
+#include "job_control.h"
+#include "line_reader.h"
+#include "arena.h"
+#include "usage.h"
+
+// One input of a 'parallel' run and the job started for it.
+typedef struct {
+    const char *arg;
+    pid_t pid;       // 0 before the job starts, -1 if it could not be started
+    FILE *output;    // The job's buffered stdout
+    int status;      // waitpid() status once finished
+    bool finished;
+} ParallelJob;
+
+// The shell's own reader for stdin, or NULL if it reads commands from elsewhere.
+static LineReader *g_stdin_reader = NULL;
+
+// --- Private Helper Functions ---
+
+// Returns a copy of 'word' with every "{}" replaced by 'arg', allocated from the line arena.
+static char* substitute_arg(const char *word, const char *arg) {
+    size_t arg_len = strlen(arg);
+    size_t len = strlen(word);
+    for (const char *p = strstr(word, "{}"); p; p = strstr(p + 2, "{}")) {
+        len += arg_len - 2;
+    }
+    char *result = arena_alloc(&g_line_arena, len + 1);
+    char *out = result;
+    const char *p;
+    while ((p = strstr(word, "{}")) != NULL) {
+        memcpy(out, word, p - word);
+        out += p - word;
+        memcpy(out, arg, arg_len);
+        out += arg_len;
+        word = p + 2;
+    }
+    strcpy(out, word);
+    return result;
+}
+
+// Builds the tokens for one job from the command template. If the template has no
+// "{}", the argument is appended as the last word. The tokens end with EOL.
+static Token* build_job_tokens(Token *template, int template_count, const char *arg, int *count) {
+    bool has_placeholder = false;
+    for (int i = 0; i < template_count; i++) {
+        if (template[i].value && strstr(template[i].value, "{}")) {
+            has_placeholder = true;
+            break;
+        }
+    }
+
+    Token *tokens = arena_alloc(&g_line_arena, (template_count + 2) * sizeof(Token));
+    int n = 0;
+    for (int i = 0; i < template_count; i++) {
+        tokens[n] = template[i];
+        if (template[i].value && has_placeholder) {
+            tokens[n].value = substitute_arg(template[i].value, arg);
+        }
+        n++;
+    }
+    if (!has_placeholder) {
+        tokens[n].type = TOKEN_NAME;
+        tokens[n].value = (char *)arg;
+        n++;
+    }
+    tokens[n].type = TOKEN_EOL;
+    tokens[n].value = NULL;
+    *count = n + 1;
+    return tokens;
+}
+
+// Reads one argument per non-empty line of stdin into the line arena. Lines the
+// shell's reader has already read ahead come first.
+static const char** read_args_from_stdin(int *count) {
+    LineReader reader;
+    line_reader_init(&reader, STDIN_FILENO);
+    if (g_stdin_reader) {
+        line_reader_take_buffered(&reader, g_stdin_reader);
+    }
+    int capacity = 16;
+    const char **args = malloc(capacity * sizeof(char *));
+    *count = 0;
+    char *line;
+    size_t len;
+    while (args && (line = line_reader_next(&reader, &len)) != NULL) {
+        if (len == 0) continue;
+        if (*count == capacity) {
+            capacity *= 2;
+            const char **grown = realloc(args, capacity * sizeof(char *));
+            if (!grown) {
+                free(args);
+                args = NULL;
+                break;
+            }
+            args = grown;
+        }
+        args[(*count)++] = arena_strdup(&g_line_arena, line);
+    }
+    line_reader_free(&reader);
+    if (!args) {
+        perror("parallel");
+        *count = 0;
+    }
+    return args;
+}
+
+// Starts one job with its stdout going to a temporary file.
+static void start_job(ParallelJob *job, Token *template, int template_count, const char *home_dir) {
+    job->output = tmpfile();
+    if (!job->output) {
+        perror("parallel: tmpfile");
+        job->pid = -1;
+        return;
+    }
+    fcntl(fileno(job->output), F_SETFD, FD_CLOEXEC);
+    int count;
+    Token *tokens = build_job_tokens(template, template_count, job->arg, &count);
+    // Jobs read /dev/null rather than competing for the terminal.
+    job->pid = launch_pipeline_stage(tokens, count, home_dir, 0, -1, fileno(job->output), true, NULL);
+}
+
+// Copies a finished job's buffered output to stdout and releases it.
+static void flush_job_output(ParallelJob *job) {
+    if (!job->output) {
+        return;
+    }
+    fflush(stdout);
+    rewind(job->output);
+    char buffer[8192];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), job->output)) > 0) {
+        fwrite(buffer, 1, n, stdout);
+    }
+    fflush(stdout);
+    fclose(job->output);
+    job->output = NULL;
+}
+
+// Waits for 'job' with waitpid() 'options'. Returns true if it has finished. The
+// jobs share the shell's process group, so Ctrl-Z stops them too; 'parallel'
+// cannot be suspended, so a stopped job is resumed.
+static bool wait_for_job(ParallelJob *job, int options) {
+    if (wait_for_foreground(job->pid, &job->status, options | WUNTRACED, job->arg) != job->pid) {
+        return false;
+    }
+    if (WIFSTOPPED(job->status)) {
+        kill(job->pid, SIGCONT);
+        return false;
+    }
+    job->finished = true;
+    return true;
+}
+
+// Reaps any running job that has finished. If none has, blocks until a child
+// changes state. Returns the number of jobs reaped.
+static int reap_finished_jobs(ParallelJob *jobs, int started) {
+    int reaped = 0;
+    int first_running = -1;
+    for (int i = 0; i < started; i++) {
+        if (jobs[i].pid <= 0 || jobs[i].finished) continue;
+        if (first_running < 0) first_running = i;
+        if (wait_for_job(&jobs[i], WNOHANG)) {
+            reaped++;
+        }
+    }
+    if (reaped > 0 || first_running < 0) {
+        return reaped;
+    }
+
+    // Nothing finished yet: sleep until SIGCHLD, or on the oldest job if the
+    // event pipe is unavailable.
+    int event_fd = jobs_event_fd();
+    if (event_fd >= 0) {
+        struct pollfd pfd = {.fd = event_fd, .events = POLLIN};
+        if (poll(&pfd, 1, -1) > 0) {
+            char drain[64];
+            while (read(event_fd, drain, sizeof(drain)) > 0) {}
+        }
+    } else if (wait_for_job(&jobs[first_running], 0)) {
+        reaped++;
+    }
+    return reaped;
+}
+
+// --- Public API Implementation ---
+
+void set_parallel_stdin_reader(LineReader *reader) {
+    g_stdin_reader = reader;
+}
+
+int handle_parallel(Token *tokens, int token_count, const char *home_dir) {
+    // 'parallel [N] cmd [args...] [::: inputs...]'
+    int first = 1;
+    long max_jobs = 0;
+    char *endptr;
+    if (first < token_count - 1 && tokens[first].type == TOKEN_NAME) {
+        long value = strtol(tokens[first].value, &endptr, 10);
+        if (*endptr == '\0' && tokens[first].value[0] != '\0') {
+            if (value < 0) {
+                printf("parallel: Invalid Syntax!\n");
+                return 1;
+            }
+            max_jobs = value;
+            first++;
+        }
+    }
+    if (max_jobs == 0) {
+        // Default to one job per online CPU.
+        max_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+        if (max_jobs < 1) max_jobs = 1;
+    }
+
+    int separator = -1;
+    for (int i = first; i < token_count - 1; i++) {
+        if (tokens[i].type == TOKEN_NAME && strcmp(tokens[i].value, ":::") == 0) {
+            separator = i;
+            break;
+        }
+    }
+    int template_count = ((separator < 0) ? token_count - 1 : separator) - first;
+    if (template_count <= 0 || tokens[first].type != TOKEN_NAME) {
+        printf("parallel: Invalid Syntax!\n");
+        return 1;
+    }
+    // Inputs are plain words; redirections belong in the command template.
+    for (int i = separator + 1; separator >= 0 && i < token_count - 1; i++) {
+        if (tokens[i].type != TOKEN_NAME) {
+            printf("parallel: Invalid Syntax!\n");
+            return 1;
+        }
+    }
+    Token *template = &tokens[first];
+
+    // Gather the inputs: the words after ':::' or, without it, the lines of stdin.
+    int num_args;
+    const char **args;
+    if (separator >= 0) {
+        num_args = token_count - 1 - (separator + 1);
+        args = malloc((num_args > 0 ? num_args : 1) * sizeof(char *));
+        for (int i = 0; args && i < num_args; i++) {
+            args[i] = tokens[separator + 1 + i].value;
+        }
+    } else {
+        args = read_args_from_stdin(&num_args);
+    }
+    ParallelJob *jobs = args ? calloc(num_args > 0 ? num_args : 1, sizeof(ParallelJob)) : NULL;
+    if (!jobs) {
+        perror("parallel");
+        free(args);
+        return 1;
+    }
+    for (int i = 0; i < num_args; i++) {
+        jobs[i].arg = args[i];
+    }
+
+    // The jobs stay in the shell's process group, like a script's commands, so a
+    // Ctrl-C from the terminal reaches all of them at once.
+    bool saved_job_control = g_job_control;
+    g_job_control = false;
+
+    // Keep up to max_jobs running, and print each job's output in input order as
+    // soon as it and every job before it are done.
+    int started = 0;
+    int running = 0;
+    int next_to_flush = 0;
+    int failed = 0;
+    while (next_to_flush < num_args) {
+        while (started < num_args && running < max_jobs) {
+            start_job(&jobs[started], template, template_count, home_dir);
+            if (jobs[started].pid > 0) running++;
+            started++;
+        }
+        running -= reap_finished_jobs(jobs, started);
+        while (next_to_flush < started &&
+               (jobs[next_to_flush].pid <= 0 || jobs[next_to_flush].finished)) {
+            ParallelJob *job = &jobs[next_to_flush++];
+            flush_job_output(job);
+            if (job->pid <= 0 || !WIFEXITED(job->status) || WEXITSTATUS(job->status) != 0) {
+                failed++;
+            }
+        }
+    }
+
+    g_job_control = saved_job_control;
+    // The SIGCHLD pipe was drained above, so catch up on background jobs now.
+    check_background_jobs();
+
+    if (failed > 0) {
+        fprintf(stderr, "parallel: %d of %d jobs failed\n", failed, num_args);
+    }
+    free(jobs);
+    free(args);
+    return (failed > 0) ? 1 : 0;
+}
@@ -1,5 +1,7 @@
 #include "parser.h"
+#include "variables.h"
 #include <stdio.h>
+#include <string.h>
 
 // --- Parser State and Helpers ---
 
@@ -7,6 +9,8 @@ typedef struct {
     Token *tokens;
     int count;
     int current;
+    int loop_depth;   // How many loops enclose the current token
+    ExecutionPlan *plan;
 } ParserState;
 
 static Token current_token(ParserState *state) {
@@ -19,119 +23,319 @@ static void advance_token(ParserState *state) {
     }
 }
 
-// --- Forward declarations for recursive functions ---
-
-static bool parse_cmd_group(ParserState *state);
+// Returns true if the current token is the reserved word 'word'. Reserved words
+// are only recognized where a command could start.
+static bool at_keyword(ParserState *state, const char *word) {
+    Token token = current_token(state);
+    return token.type == TOKEN_NAME && strcmp(token.value, word) == 0;
+}
 
-// --- Grammar Rule Implementations ---
+// Makes room for one more element in an array allocated from the plan's arena,
+// doubling it when full. The old array is simply left behind in the arena.
+static void* grow_array(ParserState *state, void *array, int count, int *capacity, size_t element_size) {
+    if (count < *capacity) {
+        return array;
+    }
+    int new_capacity = (*capacity == 0) ? 4 : *capacity * 2;
+    void *grown = arena_alloc(&state->plan->arena, new_capacity * element_size);
+    if (count > 0) {
+        memcpy(grown, array, count * element_size);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
 
-// Rule: output -> (> | >>) name
-static bool parse_output(ParserState *state) {
-    if (current_token(state).type == TOKEN_REDIRECT_OUT || current_token(state).type == TOKEN_REDIRECT_APPEND) {
-        advance_token(state); // Consume '>' or '>>'
-        if (current_token(state).type == TOKEN_NAME) {
-            advance_token(state); // Consume filename
-            return true;
-        }
-        return false; // Missing filename after redirection
+// Returns the text of an operator token.
+static const char* operator_text(TokenType type) {
+    switch (type) {
+        case TOKEN_PIPE:            return "|";
+        case TOKEN_REDIRECT_IN:     return "<";
+        case TOKEN_REDIRECT_OUT:    return ">";
+        case TOKEN_REDIRECT_APPEND: return ">>";
+        case TOKEN_AND_IF:          return "&&";
+        case TOKEN_OR_IF:           return "||";
+        case TOKEN_SEMICOLON:       return ";";
+        case TOKEN_AMPERSAND:       return "&";
+        default:                    return NULL;
     }
-    return false;
 }
 
-// Rule: input -> < name
-static bool parse_input(ParserState *state) {
-    if (current_token(state).type == TOKEN_REDIRECT_IN) {
-        advance_token(state); // Consume '<'
-        if (current_token(state).type == TOKEN_NAME) {
-            advance_token(state); // Consume filename
-            return true;
-        }
-        return false; // Missing filename after redirection
+// Joins the tokens in [first, last) into a user-facing command string, allocated
+// from the plan's arena. This is used for job control messages.
+static const char* command_text(ParserState *state, int first, int last) {
+    size_t len = 0;
+    for (int i = first; i < last; i++) {
+        const char *text = state->tokens[i].value ? state->tokens[i].value : operator_text(state->tokens[i].type);
+        if (text) len += strlen(text) + 1; // For the separating space
     }
-    return false;
+
+    char *str = arena_alloc(&state->plan->arena, len + 1);
+    char *out = str;
+    for (int i = first; i < last; i++) {
+        const char *text = state->tokens[i].value ? state->tokens[i].value : operator_text(state->tokens[i].type);
+        if (!text) continue;
+        if (out != str) *out++ = ' ';
+        size_t text_len = strlen(text);
+        memcpy(out, text, text_len);
+        out += text_len;
+    }
+    *out = '\0';
+    return str;
 }
 
+// --- Grammar Rule Implementations ---
+
 // Rule: atomic -> name (name | input | output)*
-static bool parse_atomic(ParserState *state) {
+//       input  -> < name
+//       output -> (> | >>) name
+static bool parse_atomic(ParserState *state, PlanCommand *command) {
     if (current_token(state).type != TOKEN_NAME) {
         return false; // An atomic command must start with a name.
     }
-    advance_token(state); // Consume the command name.
+    if (at_keyword(state, "do") || at_keyword(state, "done") || at_keyword(state, "in")) {
+        return false; // A reserved word out of place.
+    }
+    Arena *arena = &state->plan->arena;
+    int first = state->current;
+    int num_words = 0;
+    command->num_redirects = 0;
 
     while (true) {
         TokenType type = current_token(state).type;
         if (type == TOKEN_NAME) {
-            advance_token(state); // Consume argument.
-        } else if (type == TOKEN_REDIRECT_IN) {
-            if (!parse_input(state)) return false;
-        } else if (type == TOKEN_REDIRECT_OUT || type == TOKEN_REDIRECT_APPEND) {
-            if (!parse_output(state)) return false;
+            num_words++;
+            advance_token(state); // Consume the command name or an argument.
+        } else if (type == TOKEN_REDIRECT_IN || type == TOKEN_REDIRECT_OUT || type == TOKEN_REDIRECT_APPEND) {
+            advance_token(state); // Consume '<', '>' or '>>'
+            if (current_token(state).type != TOKEN_NAME) {
+                return false; // Missing filename after redirection
+            }
+            advance_token(state); // Consume filename
+            command->num_redirects++;
         } else {
             break; // Not part of an atomic command, so we stop.
         }
     }
+
+    // Copy the command's tokens into the plan, then split them into words and
+    // redirections. Both views share the copied strings.
+    int count = state->current - first;
+    command->token_count = count + 1;
+    command->tokens = arena_alloc(arena, command->token_count * sizeof(Token));
+    command->word_count = num_words + 1;
+    command->words = arena_alloc(arena, command->word_count * sizeof(Token));
+    command->redirects = arena_alloc(arena, command->num_redirects * sizeof(PlanRedirect));
+
+    int word = 0;
+    int redirect = 0;
+    for (int i = 0; i < count; i++) {
+        Token token = state->tokens[first + i];
+        if (token.value) {
+            token.value = arena_strdup(arena, token.value);
+        }
+        command->tokens[i] = token;
+        if (token.type == TOKEN_NAME) {
+            command->words[word++] = token;
+        } else {
+            // A redirection operator is always followed by its file name.
+            char *target = arena_strdup(arena, state->tokens[first + i + 1].value);
+            command->redirects[redirect].type = token.type;
+            command->redirects[redirect].target = target;
+            redirect++;
+            i++;
+            command->tokens[i].type = TOKEN_NAME;
+            command->tokens[i].value = target;
+        }
+    }
+    command->tokens[count].type = TOKEN_EOL;
+    command->tokens[count].value = NULL;
+    command->words[num_words].type = TOKEN_EOL;
+    command->words[num_words].value = NULL;
+
+    if (strcmp(command->words[0].value, "log") == 0) {
+        state->plan->runs_log = true;
+    }
     return true;
 }
 
-// Rule: cmd_group -> atomic (| atomic)*
-static bool parse_cmd_group(ParserState *state) {
-    if (!parse_atomic(state)) {
+static bool parse_list(ParserState *state, PlanList *list, const char *terminator);
+
+// Rule: loop -> for name in name* ; do list done
+//             | while list do list done
+static bool parse_loop(ParserState *state, PlanLoop *loop) {
+    loop->is_for = at_keyword(state, "for");
+    loop->variable = NULL;
+    loop->items = NULL;
+    loop->num_items = 0;
+    loop->condition.entries = NULL;
+    loop->condition.num_entries = 0;
+    advance_token(state); // Consume 'for' or 'while'
+    state->loop_depth++;
+
+    if (loop->is_for) {
+        Token name = current_token(state);
+        if (name.type != TOKEN_NAME || !is_valid_variable_name(name.value)) {
+            return false; // 'for' must be followed by a variable name.
+        }
+        loop->variable = arena_strdup(&state->plan->arena, name.value);
+        advance_token(state); // Consume the variable name
+        if (!at_keyword(state, "in")) {
+            return false;
+        }
+        advance_token(state); // Consume 'in'
+
+        int first = state->current;
+        while (current_token(state).type == TOKEN_NAME) {
+            advance_token(state); // Consume an item
+        }
+        loop->num_items = state->current - first;
+        loop->items = arena_alloc(&state->plan->arena, (loop->num_items + 1) * sizeof(Token));
+        for (int i = 0; i < loop->num_items; i++) {
+            loop->items[i].type = TOKEN_NAME;
+            loop->items[i].value = arena_strdup(&state->plan->arena, state->tokens[first + i].value);
+        }
+        loop->items[loop->num_items].type = TOKEN_EOL;
+        loop->items[loop->num_items].value = NULL;
+
+        if (current_token(state).type != TOKEN_SEMICOLON) {
+            return false; // The items end with ';'.
+        }
+        advance_token(state); // Consume ';'
+    } else if (!parse_list(state, &loop->condition, "do")) {
         return false;
     }
 
-    while (current_token(state).type == TOKEN_PIPE) {
-        advance_token(state); // Consume '|'
-        if (!parse_atomic(state)) {
+    if (!at_keyword(state, "do")) {
+        return false;
+    }
+    advance_token(state); // Consume 'do'
+    while (current_token(state).type == TOKEN_SEMICOLON) {
+        advance_token(state); // Lines joined after 'do'
+    }
+    if (!parse_list(state, &loop->body, "done")) {
+        return false;
+    }
+    advance_token(state); // Consume 'done'
+    state->loop_depth--;
+    return true;
+}
+
+// Rule: cmd_group -> time? (atomic (| atomic)* | loop)
+static bool parse_cmd_group(ParserState *state, PlanPipeline *pipeline) {
+    int capacity = 0;
+    pipeline->commands = NULL;
+    pipeline->num_commands = 0;
+    pipeline->loop = NULL;
+    pipeline->timed = false;
+
+    // 'time' only prefixes a command; on its own it is an ordinary command name.
+    if (at_keyword(state, "time") && state->tokens[state->current + 1].type == TOKEN_NAME) {
+        advance_token(state); // Consume 'time'
+        pipeline->timed = true;
+    }
+    int first = state->current;
+
+    if (at_keyword(state, "for") || at_keyword(state, "while")) {
+        pipeline->loop = arena_alloc(&state->plan->arena, sizeof(PlanLoop));
+        if (!parse_loop(state, pipeline->loop)) {
+            return false;
+        }
+        pipeline->text = command_text(state, first, state->current);
+        return true;
+    }
+
+    while (true) {
+        pipeline->commands = grow_array(state, pipeline->commands, pipeline->num_commands, &capacity, sizeof(PlanCommand));
+        if (!parse_atomic(state, &pipeline->commands[pipeline->num_commands])) {
             return false; // A pipe must be followed by a valid atomic command.
         }
+        pipeline->num_commands++;
+        if (current_token(state).type != TOKEN_PIPE) {
+            break;
+        }
+        advance_token(state); // Consume '|'
     }
+    pipeline->text = command_text(state, first, state->current);
     return true;
 }
 
-// Rule: shell_cmd -> cmd_group ((; | & | &&) cmd_group)* &?
-// This implementation handles the ambiguity of '&' being a separator or a terminator.
-static bool parse_shell_cmd(ParserState *state) {
-    if (!parse_cmd_group(state)) {
-        return false;
-    }
+// Rule: and_or -> cmd_group ((&& | ||) cmd_group)*
+static bool parse_and_or(ParserState *state, PlanAndOr *and_or) {
+    int first = state->current;
+    int capacity = 0;
+    int operator_capacity = 0;
+    and_or->pipelines = NULL;
+    and_or->operators = NULL;
+    and_or->num_pipelines = 0;
+    and_or->is_background = false;
 
     while (true) {
+        and_or->pipelines = grow_array(state, and_or->pipelines, and_or->num_pipelines, &capacity, sizeof(PlanPipeline));
+        if (!parse_cmd_group(state, &and_or->pipelines[and_or->num_pipelines])) {
+            return false; // '&&' and '||' must be followed by a command.
+        }
+        and_or->num_pipelines++;
         TokenType type = current_token(state).type;
+        if (type != TOKEN_AND_IF && type != TOKEN_OR_IF) {
+            break;
+        }
+        and_or->operators = grow_array(state, and_or->operators, and_or->num_pipelines - 1, &operator_capacity, sizeof(TokenType));
+        and_or->operators[and_or->num_pipelines - 1] = type;
+        advance_token(state); // Consume '&&' or '||'
+    }
+    and_or->text = command_text(state, first, state->current);
+    return true;
+}
 
-        // These tokens are always separators and must be followed by a command.
-        if (type == TOKEN_AND_IF || type == TOKEN_SEMICOLON) {
-            advance_token(state); // Consume '&&' or ';'
-            if (!parse_cmd_group(state)) {
-                return false; // Separator must be followed by a command.
-            }
-            continue; // Continue parsing the rest of the line.
+// Rule: list -> and_or ((; | &) and_or)* &?
+// This implementation handles the ambiguity of '&' being a separator or a terminator.
+// A top-level list ('terminator' is NULL) runs to the end of the line. Inside a
+// loop, the list ends before the reserved word 'terminator', and may end with ';'.
+static bool parse_list(ParserState *state, PlanList *list, const char *terminator) {
+    int capacity = 0;
+    list->entries = NULL;
+    list->num_entries = 0;
+
+    while (true) {
+        list->entries = grow_array(state, list->entries, list->num_entries, &capacity, sizeof(PlanAndOr));
+        PlanAndOr *entry = &list->entries[list->num_entries];
+        if (!parse_and_or(state, entry)) {
+            return false; // A separator must be followed by a command.
         }
+        list->num_entries++;
 
+        TokenType type = current_token(state).type;
+        if (type != TOKEN_SEMICOLON && type != TOKEN_AMPERSAND) {
+            break; // If the token is not a separator, we're done with the list.
+        }
         // The '&' token can be a separator OR a terminator for the whole line.
-        if (type == TOKEN_AMPERSAND) {
-            advance_token(state); // Consume '&'
-            // If '&' is the last meaningful token, it's a valid terminator.
-            if (current_token(state).type == TOKEN_EOL) {
-                return true;
-            }
-            // Otherwise, it's a separator and must be followed by a command.
-            if (!parse_cmd_group(state)) {
-                return false;
-            }
-            continue;
+        entry->is_background = (type == TOKEN_AMPERSAND);
+        advance_token(state); // Consume ';' or '&'
+        if (terminator && at_keyword(state, terminator)) {
+            return true;
         }
-
-        // If the token is not a separator, we're done with the list.
-        break;
+        // If '&' is the last meaningful token, it's a valid terminator.
+        if (!terminator && type == TOKEN_AMPERSAND && current_token(state).type == TOKEN_EOL) {
+            return true;
+        }
+        // Otherwise, it's a separator and must be followed by a command.
     }
 
-    // After a valid command, we must be at the end of the line.
-    return current_token(state).type == TOKEN_EOL;
+    // After a valid list, we must be at its end.
+    return terminator ? at_keyword(state, terminator) : current_token(state).type == TOKEN_EOL;
 }
 
 // --- Public Interface ---
 
-bool parse_command(Token *tokens, int token_count) {
-    ParserState state = {tokens, token_count, 0};
-    return parse_shell_cmd(&state);
-}
\ No newline at end of file
+ParseResult parse_command(Token *tokens, int token_count, ExecutionPlan *plan) {
+    ParserState state = {tokens, token_count, 0, 0, plan};
+    plan->runs_log = false;
+    if (parse_list(&state, &plan->list, NULL)) {
+        return PARSE_OK;
+    }
+    // Running out of tokens inside a loop only means the loop continues on the next line.
+    if (state.loop_depth > 0 && current_token(&state).type == TOKEN_EOL) {
+        return PARSE_INCOMPLETE;
+    }
+    return PARSE_INVALID;
+}
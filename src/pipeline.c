@@ -4,19 +4,22 @@
 #include <stdlib.h>
 #include <sys/wait.h>
 #include <stdio.h>
+#include <fcntl.h>
 #include "jobs.h"
 #include "job_control.h"
+#include "usage.h"
 
-void execute_pipeline(Token **segments, int *segment_counts, int num_segments, const char *home_dir, bool is_background, const char *full_command) {
+int execute_pipeline(Token **segments, int *segment_counts, int num_segments, const char *home_dir, bool is_background, const char *full_command) {
     // --- Step 2: Handle the simple case (no pipes) ---
     if (num_segments == 1) {
         // If there's only one command, just execute it directly.
         // This reuses all the logic from Phase 2 for redirection and execution.
-        handle_external_command(segments[0], segment_counts[0], home_dir, is_background, full_command);
-        return;
+        return handle_external_command(segments[0], segment_counts[0], home_dir, is_background, full_command);
     }
 
     // 1. Create Pipes
+    // Every pipe end is close-on-exec: each stage receives its own ends through
+    // dup2, so exec'd programs never inherit the other stages' descriptors.
     pid_t pgid = 0;
     int pipes[num_segments - 1][2];
     for (int i = 0; i < num_segments - 1; i++) {
@@ -24,100 +27,88 @@ void execute_pipeline(Token **segments, int *segment_counts, int num_segments, c
             perror("pipe");
             exit(EXIT_FAILURE);
         }
+        fcntl(pipes[i][0], F_SETFD, FD_CLOEXEC);
+        fcntl(pipes[i][1], F_SETFD, FD_CLOEXEC);
     }
 
-    // 2. Create an array to store child PIDs
+    // 2. Create an array to store child PIDs, and their names for 'time' reports
     pid_t pids[num_segments];
+    const char *names[num_segments];
 
-
-    // 3. Loop and Fork for each command
+    // 3. Launch one process per command.
+    bool last_started = false;
     for (int i = 0; i < num_segments; i++) {
-        // a. Fork a new child process and store its PID.
-        pids[i] = fork();
-        if (pids[i] < 0) {
-            perror("fork");
-            exit(EXIT_FAILURE);
-        }
-        
-        // b. Inside the child process (if pid == 0):
-        if(pids[i] == 0) {
-            // Child process
+        int in_fd = (i > 0) ? pipes[i - 1][0] : -1;               // Not the first command
+        int out_fd = (i < num_segments - 1) ? pipes[i][1] : -1;   // Not the last command
 
-            // E.3: Set process group and restore default signal handling.
-            // The parent will set the PGID for all children in the pipeline.
-            signal(SIGINT, SIG_DFL);
-            signal(SIGQUIT, SIG_DFL);
-            signal(SIGTSTP, SIG_DFL);
-            signal(SIGTTIN, SIG_DFL);
-            signal(SIGTTOU, SIG_DFL);
+        // Only the first stage reads the terminal, so only it needs stdin
+        // detached when the whole pipeline runs in the background.
+        pids[i] = launch_pipeline_stage(segments[i], segment_counts[i], home_dir, pgid,
+                                        in_fd, out_fd, is_background && i == 0, &names[i]);
+        last_started = pids[i] > 0;
 
-            // The parent will put this child into a process group.
-
-            // i. Set up I/O redirection using dup2().
-            if (i > 0) { // Not the first command
-                dup2(pipes[i - 1][0], STDIN_FILENO);
-            }
-            if (i < num_segments - 1) { // Not the last command
-                dup2(pipes[i][1], STDOUT_FILENO);
-            }
-            
-            // ii. Close ALL pipe file descriptors.
-            //     The child has its own copies of stdin/stdout now, so it doesn't
-            //     need the original pipe FDs. Loop through all pipes and close both ends.
-            for (int j = 0; j < num_segments - 1; j++) {
-                close(pipes[j][0]);
-                close(pipes[j][1]);
-            }
-
-            // iii. Execute the command for the current segment.
-            // From the perspective of a command inside a pipeline, it's always running in the
-            // "foreground" relative to the other pipeline components. The pipeline executor
-            // in the main parent process is responsible for backgrounding the entire job.
-            handle_external_command(segments[i], segment_counts[i], home_dir, false, NULL);
-            // iv. If returns (shoudln't on success), print an error and exit.
-            exit(EXIT_FAILURE);
+        // E.3: The first stage that starts becomes the process group leader.
+        // A stage that fails to start is skipped; its neighbours see EOF or EPIPE.
+        if (pgid == 0 && pids[i] > 0) {
+            pgid = pids[i];
         }
     }
+    // If the last stage could not start, that failure is the pipeline's status.
+    int exit_status = last_started ? 0 : launch_failure_status();
+
+    // 4. Close ALL pipe file descriptors in the parent.
+    //    This must be done after all children are started and before waiting.
+    for (int i = 0; i < num_segments - 1; i++) {
+        close(pipes[i][0]);
+        close(pipes[i][1]);
+    }
 
-    // --- Parent Process Only ---
-    // 4. E.3: Set up process group for the pipeline.
-    // The PGID of the pipeline is the PID of the first process.
-    pgid = pids[0];
+    // Keep only the stages that actually started; they make up the job.
+    int num_started = 0;
     for (int i = 0; i < num_segments; i++) {
-        if (setpgid(pids[i], pgid) < 0) {
-            perror("setpgid");
+        if (pids[i] > 0) {
+            names[num_started] = names[i];
+            pids[num_started++] = pids[i];
         }
     }
 
-    // 5. Close ALL pipe file descriptors in the parent.
-    //    This must be done after all children are forked and before waiting.
-    for (int i = 0; i < num_segments - 1; i++) {
-        close(pipes[i][0]);
-        close(pipes[i][1]);
+    // No stage could be started, so there is no job to track.
+    if (num_started == 0) {
+        return exit_status;
     }
 
-    // 6. Handle waiting or backgrounding.
+    // 5. Handle waiting or backgrounding.
     if (is_background) {
-        // For a background job, add it to the job list using the full command string.
-        add_job(pids[0], full_command);
-    } else {
-        // For a foreground job, give it terminal control and wait.
-        g_foreground_pgid = pgid;
+        // For a background job, track every stage under the full command string.
+        add_job(pgid, pids, num_started, full_command);
+        return 0;
+    }
+
+    // For a foreground job, give it terminal control and wait.
+    g_foreground_pgid = pgid;
+    if (g_job_control) {
         tcsetpgrp(g_terminal_fd, pgid);
+    }
 
-        bool job_stopped = false;
-        for (int i = 0; i < num_segments; i++) {
-            int status;
-            waitpid(pids[i], &status, WUNTRACED);
-            if (WIFSTOPPED(status)) {
-                job_stopped = true;
-            }
-        }
-        if (job_stopped) {
-            add_job_stopped(pids[0], full_command);
+    bool job_stopped = false;
+    int statuses[num_started];
+    for (int i = 0; i < num_started; i++) {
+        wait_for_foreground(pids[i], &statuses[i], WUNTRACED, names[i]);
+        if (WIFSTOPPED(statuses[i])) {
+            job_stopped = true;
         }
+    }
+    if (job_stopped) {
+        add_job_stopped(pgid, pids, statuses, num_started, full_command);
+    }
 
+    if (g_job_control) {
         tcsetpgrp(g_terminal_fd, g_shell_pgid);
-        g_foreground_pgid = 0;
     }
+    g_foreground_pgid = 0;
+
+    if (last_started) {
+        exit_status = exit_status_from_wait(statuses[num_started - 1]);
+    }
+    return exit_status;
 }
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "plan_cache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include "tokenizer.h"
+#include "trace.h"
+
+// --- Plan Cache Data Structures ---
+
+typedef struct CacheEntry {
+    ExecutionPlan plan;         // First, so a plan pointer converts back to its entry
+    char *line;                 // The command line text the plan was compiled from
+    unsigned int hash;
+    int pins;                   // Acquired and not yet released
+    bool evicted;               // Already unlinked; freed when the last pin is released
+    struct CacheEntry *next;    // Next entry in the same bucket
+    struct CacheEntry *newer;   // Recency list, most recently used at the head
+    struct CacheEntry *older;
+} CacheEntry;
+
+#define PLAN_CACHE_BUCKETS 128
+#define PLAN_CACHE_CAPACITY 64
+// Most lines compile to well under a kilobyte, so plans start with a small block.
+#define PLAN_ARENA_BLOCK 1024
+
+static CacheEntry *g_buckets[PLAN_CACHE_BUCKETS];
+static CacheEntry *g_newest = NULL;
+static CacheEntry *g_oldest = NULL;
+static int g_entry_count = 0;
+
+// --- Private Helper Functions ---
+
+// djb2 string hash.
+static unsigned int hash_line(const char *line) {
+    unsigned int hash = 5381;
+    for (const unsigned char *p = (const unsigned char *)line; *p; p++) {
+        hash = hash * 33 + *p;
+    }
+    return hash;
+}
+
+static void unlink_recency(CacheEntry *entry) {
+    if (entry->newer) entry->newer->older = entry->older; else g_newest = entry->older;
+    if (entry->older) entry->older->newer = entry->newer; else g_oldest = entry->newer;
+}
+
+static void push_newest(CacheEntry *entry) {
+    entry->newer = NULL;
+    entry->older = g_newest;
+    if (g_newest) g_newest->newer = entry; else g_oldest = entry;
+    g_newest = entry;
+}
+
+static void free_entry(CacheEntry *entry) {
+    arena_destroy(&entry->plan.arena);
+    free(entry->line);
+    free(entry);
+}
+
+// Removes an entry from the table. It is freed now, or on its last release if
+// a caller is still executing it.
+static void evict_entry(CacheEntry *entry) {
+    CacheEntry **link = &g_buckets[entry->hash % PLAN_CACHE_BUCKETS];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+    unlink_recency(entry);
+    g_entry_count--;
+    if (entry->pins > 0) {
+        entry->evicted = true;
+    } else {
+        free_entry(entry);
+    }
+}
+
+// Compiles a line into a new, unlinked entry. Returns NULL if the line does not
+// compile, with the reason in 'result'.
+static CacheEntry* compile_line(const char *line, unsigned int hash, ParseResult *result) {
+    CacheEntry *entry = calloc(1, sizeof(CacheEntry));
+    if (!entry || !(entry->line = strdup(line))) {
+        perror("malloc for plan cache");
+        exit(EXIT_FAILURE);
+    }
+    entry->hash = hash;
+    entry->plan.arena.block_size = PLAN_ARENA_BLOCK;
+
+    // The tokens are only needed while parsing; the plan copies what it keeps.
+    int token_count = 0;
+    uint64_t span = trace_begin();
+    Token *tokens = tokenize(&g_line_arena, line, &token_count);
+    trace_end("tokenize", span, NULL);
+    span = trace_begin();
+    *result = parse_command(tokens, token_count, &entry->plan);
+    trace_end("parse_command", span, NULL);
+    if (*result != PARSE_OK) {
+        free_entry(entry);
+        return NULL;
+    }
+    return entry;
+}
+
+// --- Public API Implementation ---
+
+ExecutionPlan* plan_cache_acquire(const char *line, ParseResult *result) {
+    unsigned int hash = hash_line(line);
+    CacheEntry *entry = g_buckets[hash % PLAN_CACHE_BUCKETS];
+    while (entry && (entry->hash != hash || strcmp(entry->line, line) != 0)) {
+        entry = entry->next;
+    }
+
+    *result = PARSE_OK;
+    if (entry) {
+        unlink_recency(entry);
+    } else {
+        entry = compile_line(line, hash, result);
+        if (!entry) {
+            return NULL;
+        }
+        // Make room by dropping the least recently used plans.
+        while (g_entry_count >= PLAN_CACHE_CAPACITY) {
+            evict_entry(g_oldest);
+        }
+        CacheEntry **bucket = &g_buckets[hash % PLAN_CACHE_BUCKETS];
+        entry->next = *bucket;
+        *bucket = entry;
+        g_entry_count++;
+    }
+    push_newest(entry);
+    entry->pins++;
+    return &entry->plan;
+}
+
+void plan_cache_release(ExecutionPlan *plan) {
+    CacheEntry *entry = (CacheEntry *)((char *)plan - offsetof(CacheEntry, plan));
+    entry->pins--;
+    if (entry->pins == 0 && entry->evicted) {
+        free_entry(entry);
+    }
+}
+
+void cleanup_plan_cache(void) {
+    while (g_oldest) {
+        evict_entry(g_oldest);
+    }
+}
@@ -1,43 +1,236 @@
 #include<stdio.h>
+#include<stdlib.h>
 #include<unistd.h>
 #include<pwd.h>
 #include<sys/types.h>
 #include "prompt.h"
 #include <string.h>
- 
-void display_prompt(char* home_dir) {
-    char hostname[256];
+#include <stdbool.h>
+#include <time.h>
+#include "variables.h"
+#include "prompt_segments.h"
+
+// The prompt used when $PROMPT is not set: "<user@host:~/dir> ".
+#define DEFAULT_PROMPT_FORMAT "<\\u@\\H:\\w> "
+
+// The inputs of the prompt. The user and host never change while the shell runs,
+// so they are looked up once; the directory is updated by 'hop'.
+static char g_user[256] = "";
+static char g_host[256] = "";
+static char g_cwd[1024] = "";
+static char g_home_dir[1024] = "";
+
+// The rendered prompt, and the format it was rendered from.
+static char g_prompt[4096];
+static char *g_format = NULL;
+static bool g_prompt_valid = false;
+
+// When the prompt was last printed. A prompt is only redrawn in place for fresh
+// segment values shortly after it appeared; after that the next prompt shows them.
+static struct timespec g_prompt_shown_at;
+#define PROMPT_REDRAW_WINDOW_MS 500
+
+// --- Private Helper Functions ---
+
+// Returns the number of columns 'text' takes on screen: escape sequences take
+// none, and a UTF-8 character takes one.
+static int visible_width(const char *text) {
+    int width = 0;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        if (*p == '\033' && p[1] == '[') {
+            p += 2;
+            while (*p && !(*p >= 0x40 && *p <= 0x7e)) p++; // Up to the final byte
+            if (!*p) break;
+        } else if ((*p & 0xc0) != 0x80) {
+            width++;
+        }
+    }
+    return width;
+}
+
+// Appends 'text' to the prompt being built, truncating it if the buffer is full.
+static void append_text(size_t *len, const char *text, size_t text_len) {
+    if (*len + text_len >= sizeof(g_prompt)) {
+        text_len = sizeof(g_prompt) - 1 - *len;
+    }
+    memcpy(g_prompt + *len, text, text_len);
+    *len += text_len;
+}
+
+// Appends the directory, with the home directory shown as '~'.
+static void append_directory(size_t *len, bool basename_only) {
+    const char *dir = g_cwd;
+    size_t home_len = strlen(g_home_dir);
+    bool in_home = home_len > 0 && strncmp(g_cwd, g_home_dir, home_len) == 0 &&
+                   (g_cwd[home_len] == '\0' || g_cwd[home_len] == '/');
+
+    if (basename_only) {
+        if (in_home && g_cwd[home_len] == '\0') {
+            append_text(len, "~", 1);
+            return;
+        }
+        const char *slash = strrchr(dir, '/');
+        if (slash && slash[1] != '\0') {
+            dir = slash + 1;
+        }
+    } else if (in_home) {
+        append_text(len, "~", 1);
+        dir = g_cwd + home_len;
+    }
+    append_text(len, dir, strlen(dir));
+}
+
+// Renders the prompt from its format. Escapes: \u user, \h host (up to the first
+// '.'), \H full host, \w directory, \W last part of the directory, \n newline,
+// \\ backslash, \{name} a prompt segment.
+static void render_prompt(const char *format) {
+    size_t len = 0;
+    for (const char *p = format; *p; p++) {
+        if (*p != '\\' || p[1] == '\0') {
+            append_text(&len, p, 1);
+            continue;
+        }
+        p++;
+        switch (*p) {
+            case 'u': append_text(&len, g_user, strlen(g_user)); break;
+            case 'h': append_text(&len, g_host, strcspn(g_host, ".")); break;
+            case 'H': append_text(&len, g_host, strlen(g_host)); break;
+            case 'w': append_directory(&len, false); break;
+            case 'W': append_directory(&len, true); break;
+            case 'n': append_text(&len, "\n", 1); break;
+            case '{': {
+                const char *close = strchr(p, '}');
+                if (!close) {
+                    append_text(&len, p - 1, 2);
+                    break;
+                }
+                char value[PROMPT_SEGMENT_MAX_TEXT];
+                prompt_segment_value(p + 1, close - p - 1, g_cwd, value, sizeof(value));
+                append_text(&len, value, strlen(value));
+                p = close;
+                break;
+            }
+            case '\\': append_text(&len, "\\", 1); break;
+            default: append_text(&len, p - 1, 2); break; // Not an escape
+        }
+    }
+    g_prompt[len] = '\0';
+}
+
+// --- Public API Implementation ---
+
+void init_prompt(const char *home_dir) {
+    snprintf(g_home_dir, sizeof(g_home_dir), "%s", home_dir);
+
     // gethostname returns 0 on success, -1 on error.
-    if (gethostname(hostname, sizeof(hostname)) != 0) {
-        // If it fails, we can use a default or print an error.
-        // perror is great because it prints our message, a colon,
-        // and then the system error message.
+    if (gethostname(g_host, sizeof(g_host)) != 0) {
         perror("gethostname");
-        return; 
+        g_host[0] = '\0';
     }
+    g_host[sizeof(g_host) - 1] = '\0';
 
-    // getpwuid is more reliable than getlogin
-    uid_t uid = getuid();
-    struct passwd *pw = getpwuid(uid);
+    // getpwuid is more reliable than getlogin, but may have to ask a directory
+    // service, which is why it is only called here.
+    struct passwd *pw = getpwuid(getuid());
     if (pw == NULL) {
         perror("getpwuid");
-        return;
+    } else {
+        snprintf(g_user, sizeof(g_user), "%s", pw->pw_name);
     }
- 
-    char current_dir[1024];
-    if (getcwd(current_dir, sizeof(current_dir)) == NULL) {
+
+    if (getcwd(g_cwd, sizeof(g_cwd)) == NULL) {
         perror("getcwd");
-        return;
     }
-    
-    // Replace the home directory with a tilde if the CWD is inside it.
-    if (strncmp(current_dir, home_dir, strlen(home_dir)) == 0) {
-        char temp_path[1024];
-        snprintf(temp_path, sizeof(temp_path), "~%s", current_dir + strlen(home_dir));
-        strncpy(current_dir, temp_path, sizeof(current_dir));
+    g_prompt_valid = false;
+}
+
+void prompt_set_cwd(const char *cwd) {
+    snprintf(g_cwd, sizeof(g_cwd), "%s", cwd);
+    g_prompt_valid = false;
+}
+
+// Renders the prompt again if any of its inputs changed. Returns false if there
+// is no prompt to show.
+static bool update_prompt(void) {
+    const char *format = get_variable("PROMPT", 6);
+    if (!format) {
+        format = DEFAULT_PROMPT_FORMAT;
+    }
+    if (!g_prompt_valid || strcmp(format, g_format) != 0) {
+        free(g_format);
+        g_format = strdup(format);
+        if (!g_format) {
+            perror("strdup for prompt");
+            return false;
+        }
+        g_prompt_valid = false;
+    }
+    if (!g_prompt_valid) {
+        render_prompt(g_format);
+        g_prompt_valid = true;
+    }
+    return true;
+}
+
+void display_prompt(void) {
+    // Segments are refreshed for every new prompt, since a command may have changed
+    // what they show; async ones are only requested here and arrive later.
+    const char *format = get_variable("PROMPT", 6);
+    if (format && strstr(format, "\\{") && refresh_prompt_segments(format, g_cwd)) {
+        g_prompt_valid = false;
+    }
+    // The prompt is only rendered again when the directory, $PROMPT or a segment changed.
+    if (!update_prompt()) {
+        return;
     }
 
-    // pw->pw_name contains the username string
-    printf("<%s@%s:%s> ", pw->pw_name, hostname, current_dir);
+    fputs(g_prompt, stdout);
     fflush(stdout); // Ensure the prompt is displayed immediately.
-}
\ No newline at end of file
+    clock_gettime(CLOCK_MONOTONIC, &g_prompt_shown_at);
+}
+
+void prompt_segments_updated(void) {
+    if (!process_prompt_segment_events()) {
+        return;
+    }
+    g_prompt_valid = false;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed_ms = (now.tv_sec - g_prompt_shown_at.tv_sec) * 1000 +
+                      (now.tv_nsec - g_prompt_shown_at.tv_nsec) / 1000000;
+    if (elapsed_ms > PROMPT_REDRAW_WINDOW_MS) {
+        return; // The next prompt shows the new values.
+    }
+
+    // Redraw in place. The user may have started typing: the terminal only echoes
+    // that input and the shell cannot see it before Enter, so it must stay on
+    // screen. The rest of the line is shifted by the change in width, with the
+    // insert or delete character sequence, before the new prompt is written
+    // over the old one, and the cursor is put back after the input.
+    char old_prompt[sizeof(g_prompt)];
+    memcpy(old_prompt, g_prompt, sizeof(g_prompt));
+    if (!update_prompt() || strcmp(old_prompt, g_prompt) == 0 || strchr(g_prompt, '\n')) {
+        return;
+    }
+    int shift = visible_width(g_prompt) - visible_width(old_prompt);
+    printf("\0337\r"); // Save the cursor, go to the start of the line.
+    if (shift > 0) {
+        printf("\033[%d@", shift);
+    } else if (shift < 0) {
+        printf("\033[%dP", -shift);
+    }
+    printf("%s\0338", g_prompt); // Restore the cursor...
+    if (shift > 0) {
+        printf("\033[%dC", shift); // ...and move it with the input.
+    } else if (shift < 0) {
+        printf("\033[%dD", -shift);
+    }
+    fflush(stdout);
+}
+
+void cleanup_prompt(void) {
+    free(g_format);
+    g_format = NULL;
+    g_prompt_valid = false;
+}
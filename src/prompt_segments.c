@@ -0,0 +1,402 @@
+#define _GNU_SOURCE // For pipe2(): the worker's pipes must be close-on-exec atomically
+#include "prompt_segments.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "command_hash.h"
+
+extern char **environ;
+
+// --- Segment Table ---
+
+typedef struct {
+    const PromptSegment *segment;
+    char value[PROMPT_SEGMENT_MAX_TEXT];
+    char value_cwd[1024];   // The directory an async value was computed for
+    bool has_value;
+} SegmentSlot;
+
+#define MAX_PROMPT_SEGMENTS 16
+
+static SegmentSlot g_slots[MAX_PROMPT_SEGMENTS];
+static int g_num_slots = 0;
+
+// --- Worker State ---
+// Everything below is shared with the worker thread and guarded by g_lock. The
+// worker only holds the lock to pick up a request or store a result, never while
+// computing, so the main thread never waits for a segment.
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static pthread_t g_worker;
+static bool g_worker_started = false;
+static bool g_stop = false;
+static bool g_request_pending = false;
+static unsigned int g_request_mask = 0;   // Bit i set: compute g_slots[i]
+static char g_request_cwd[1024];
+static bool g_values_changed = false;
+// The worker writes a byte here whenever it stores a new value.
+static int g_notify_pipe[2] = {-1, -1};
+
+// Resolved once on the main thread, so the worker never reads the shell's
+// variables or command hash: the git program and the environment to run it with.
+static char *g_git_path = NULL;
+static char **g_worker_env = NULL;
+
+// The 'duration' segment's input, only touched by the main thread.
+static double g_last_duration = -1.0;
+
+// --- Built-in Segments ---
+
+// Reads the first line of a small file into 'out'. Returns false if it cannot be read.
+static bool read_first_line(const char *path, char *out, size_t out_size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    ssize_t n = read(fd, out, out_size - 1);
+    close(fd);
+    if (n <= 0) {
+        return false;
+    }
+    out[n] = '\0';
+    out[strcspn(out, "\r\n")] = '\0';
+    return true;
+}
+
+// Finds the repository enclosing 'cwd'. On success, 'root' is the work tree and
+// 'git_dir' the directory holding HEAD (they differ for linked work trees).
+static bool find_git_repository(const char *cwd, char *root, char *git_dir, size_t size) {
+    snprintf(root, size, "%s", cwd);
+    while (true) {
+        char dot_git[2048];
+        snprintf(dot_git, sizeof(dot_git), "%s/.git", root[1] ? root : "");
+        struct stat st;
+        if (stat(dot_git, &st) == 0) {
+            if (S_ISDIR(st.st_mode)) {
+                return (size_t)snprintf(git_dir, size, "%s", dot_git) < size;
+            }
+            // A linked work tree has a ".git" file saying "gitdir: <path>".
+            char line[1024];
+            if (read_first_line(dot_git, line, sizeof(line)) && strncmp(line, "gitdir: ", 8) == 0) {
+                int n = line[8] == '/' ? snprintf(git_dir, size, "%s", line + 8)
+                                       : snprintf(git_dir, size, "%s/%s", root, line + 8);
+                return (size_t)n < size; // A truncated path would name the wrong directory.
+            }
+        }
+        char *slash = strrchr(root, '/');
+        if (!slash || root[1] == '\0') {
+            return false;
+        }
+        if (slash == root) {
+            slash[1] = '\0'; // Go up to "/"
+        } else {
+            *slash = '\0';
+        }
+    }
+}
+
+// Returns true if tracked files in the work tree at 'root' have changes, by running
+// "git status" and checking whether it printed anything. The child is reaped by the
+// shell's SIGCHLD handling like any other unknown child, so it is never waited for here.
+static bool git_is_dirty(const char *root) {
+    if (!g_git_path) {
+        return false;
+    }
+    int out[2];
+    if (pipe2(out, O_CLOEXEC) < 0) {
+        return false;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+
+    // Its own process group keeps it away from the terminal and its signals.
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    sigset_t all_signals;
+    sigset_t empty_mask;
+    sigfillset(&all_signals);
+    sigemptyset(&empty_mask);
+    posix_spawnattr_setsigdefault(&attr, &all_signals);
+    posix_spawnattr_setsigmask(&attr, &empty_mask);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP);
+
+    char *argv[] = {"git", "--no-optional-locks", "-C", (char *)root, "status", "--porcelain",
+                    "--untracked-files=no", NULL};
+    pid_t pid;
+    int err = posix_spawn(&pid, g_git_path, &actions, &attr, argv, g_worker_env);
+    posix_spawnattr_destroy(&attr);
+    posix_spawn_file_actions_destroy(&actions);
+    close(out[1]);
+
+    bool dirty = false;
+    if (err == 0) {
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(out[0], buffer, sizeof(buffer))) != 0) {
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) break;
+            dirty = true; // Keep reading so git is not stopped by a full pipe.
+        }
+    }
+    close(out[0]);
+    return dirty;
+}
+
+static void compute_git_segment(const char *cwd, char *out, size_t out_size) {
+    char root[1024];
+    char git_dir[1024];
+    if (!find_git_repository(cwd, root, git_dir, sizeof(root))) {
+        return;
+    }
+    char head_path[1100];
+    char head[256];
+    snprintf(head_path, sizeof(head_path), "%s/HEAD", git_dir);
+    if (!read_first_line(head_path, head, sizeof(head))) {
+        return;
+    }
+    const char *branch = head;
+    if (strncmp(head, "ref: refs/heads/", 16) == 0) {
+        branch = head + 16;
+    } else if (strncmp(head, "ref: ", 5) == 0) {
+        branch = head + 5;
+    } else {
+        head[7] = '\0'; // A detached HEAD is shown as a short commit id.
+    }
+    snprintf(out, out_size, "%s%s", branch, git_is_dirty(root) ? "*" : "");
+}
+
+static void compute_duration_segment(const char *cwd, char *out, size_t out_size) {
+    double seconds = g_last_duration;
+    if (seconds < 0) {
+        return;
+    }
+    if (seconds < 1.0) {
+        snprintf(out, out_size, "%dms", (int)(seconds * 1000));
+    } else if (seconds < 60.0) {
+        snprintf(out, out_size, "%.1fs", seconds);
+    } else {
+        snprintf(out, out_size, "%dm%ds", (int)(seconds / 60), (int)seconds % 60);
+    }
+}
+
+static const PromptSegment g_git_segment = {"git", true, compute_git_segment};
+static const PromptSegment g_duration_segment = {"duration", false, compute_duration_segment};
+
+// --- Private Helper Functions ---
+
+static SegmentSlot* find_slot(const char *name, size_t name_len) {
+    for (int i = 0; i < g_num_slots; i++) {
+        const char *slot_name = g_slots[i].segment->name;
+        if (strncmp(slot_name, name, name_len) == 0 && slot_name[name_len] == '\0') {
+            return &g_slots[i];
+        }
+    }
+    return NULL;
+}
+
+// Returns true if 'format' contains "\{name}".
+static bool format_uses(const char *format, const char *name) {
+    size_t name_len = strlen(name);
+    for (const char *p = strstr(format, "\\{"); p; p = strstr(p + 2, "\\{")) {
+        if (strncmp(p + 2, name, name_len) == 0 && p[2 + name_len] == '}') {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Stores a freshly computed value. Returns true if what the prompt shows changes.
+// Must be called with g_lock held.
+static bool store_value(SegmentSlot *slot, const char *value, const char *cwd) {
+    if (slot->has_value && strcmp(slot->value, value) == 0 && strcmp(slot->value_cwd, cwd) == 0) {
+        return false;
+    }
+    snprintf(slot->value, sizeof(slot->value), "%s", value);
+    snprintf(slot->value_cwd, sizeof(slot->value_cwd), "%s", cwd);
+    slot->has_value = true;
+    return true;
+}
+
+// The worker thread: computes the async segments of the latest request, then
+// sleeps until the next one. Requests made while it is busy are coalesced.
+static void* segment_worker(void *arg) {
+    char cwd[sizeof(g_request_cwd)];
+    char text[PROMPT_SEGMENT_MAX_TEXT];
+
+    pthread_mutex_lock(&g_lock);
+    while (true) {
+        while (!g_request_pending && !g_stop) {
+            pthread_cond_wait(&g_wake, &g_lock);
+        }
+        if (g_stop) {
+            break;
+        }
+        unsigned int mask = g_request_mask;
+        memcpy(cwd, g_request_cwd, sizeof(cwd));
+        g_request_pending = false;
+
+        bool changed = false;
+        for (int i = 0; i < g_num_slots && !g_stop; i++) {
+            if (!(mask & (1u << i))) {
+                continue;
+            }
+            const PromptSegment *segment = g_slots[i].segment;
+            pthread_mutex_unlock(&g_lock);
+            text[0] = '\0';
+            segment->compute(cwd, text, sizeof(text));
+            pthread_mutex_lock(&g_lock);
+            changed |= store_value(&g_slots[i], text, cwd);
+        }
+        if (changed) {
+            g_values_changed = true;
+            ssize_t ignored = write(g_notify_pipe[1], "x", 1);
+            (void)ignored; // A full pipe already has a wake-up pending.
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+    return NULL;
+}
+
+// Copies the environment for the worker's child processes.
+static char** copy_environment(void) {
+    int count = 0;
+    while (environ && environ[count]) {
+        count++;
+    }
+    char **copy = malloc((count + 1) * sizeof(char *));
+    if (!copy) {
+        return NULL;
+    }
+    for (int i = 0; i < count; i++) {
+        copy[i] = strdup(environ[i]);
+    }
+    copy[count] = NULL;
+    return copy;
+}
+
+// --- Public API Implementation ---
+
+bool register_prompt_segment(const PromptSegment *segment) {
+    pthread_mutex_lock(&g_lock);
+    bool ok = g_num_slots < MAX_PROMPT_SEGMENTS && !find_slot(segment->name, strlen(segment->name));
+    if (ok) {
+        g_slots[g_num_slots].segment = segment;
+        g_slots[g_num_slots].has_value = false;
+        g_num_slots++;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return ok;
+}
+
+void init_prompt_segments(void) {
+    register_prompt_segment(&g_git_segment);
+    register_prompt_segment(&g_duration_segment);
+
+    const char *git_path = hash_lookup_command("git");
+    if (git_path) {
+        g_git_path = strdup(git_path);
+    }
+    g_worker_env = copy_environment();
+
+    if (pipe2(g_notify_pipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+        perror("pipe for prompt segments");
+        return;
+    }
+    // The worker must not take the shell's signals, so it starts with all blocked.
+    sigset_t all_signals;
+    sigset_t old_mask;
+    sigfillset(&all_signals);
+    pthread_sigmask(SIG_SETMASK, &all_signals, &old_mask);
+    int err = pthread_create(&g_worker, NULL, segment_worker, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+    if (err != 0) {
+        fprintf(stderr, "prompt segments: %s\n", strerror(err));
+        return;
+    }
+    g_worker_started = true;
+}
+
+bool refresh_prompt_segments(const char *format, const char *cwd) {
+    bool changed = false;
+    unsigned int mask = 0;
+    char text[PROMPT_SEGMENT_MAX_TEXT];
+
+    pthread_mutex_lock(&g_lock);
+    for (int i = 0; i < g_num_slots; i++) {
+        const PromptSegment *segment = g_slots[i].segment;
+        if (!format_uses(format, segment->name)) {
+            continue;
+        }
+        if (segment->is_async) {
+            mask |= 1u << i;
+            continue;
+        }
+        // Synchronous segments are cheap by definition, so computing one here
+        // only delays the worker by as much.
+        text[0] = '\0';
+        segment->compute(cwd, text, sizeof(text));
+        changed |= store_value(&g_slots[i], text, cwd);
+    }
+    if (mask && g_worker_started) {
+        snprintf(g_request_cwd, sizeof(g_request_cwd), "%s", cwd);
+        g_request_mask = mask;
+        g_request_pending = true;
+        pthread_cond_signal(&g_wake);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return changed;
+}
+
+void prompt_segment_value(const char *name, size_t name_len, const char *cwd, char *out, size_t out_size) {
+    out[0] = '\0';
+    pthread_mutex_lock(&g_lock);
+    SegmentSlot *slot = find_slot(name, name_len);
+    if (slot && slot->has_value && (!slot->segment->is_async || strcmp(slot->value_cwd, cwd) == 0)) {
+        snprintf(out, out_size, "%s", slot->value);
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+int prompt_segments_event_fd(void) {
+    return g_notify_pipe[0];
+}
+
+bool process_prompt_segment_events(void) {
+    char drain[64];
+    while (g_notify_pipe[0] >= 0 && read(g_notify_pipe[0], drain, sizeof(drain)) > 0) {}
+    pthread_mutex_lock(&g_lock);
+    bool changed = g_values_changed;
+    g_values_changed = false;
+    pthread_mutex_unlock(&g_lock);
+    return changed;
+}
+
+void prompt_segments_set_duration(double seconds) {
+    g_last_duration = seconds;
+}
+
+void cleanup_prompt_segments(void) {
+    if (!g_worker_started) {
+        return;
+    }
+    // The worker may be waiting on git; let process exit end it rather than join.
+    pthread_mutex_lock(&g_lock);
+    g_stop = true;
+    pthread_cond_signal(&g_wake);
+    pthread_mutex_unlock(&g_lock);
+    pthread_detach(g_worker);
+    g_worker_started = false;
+}
@@ -0,0 +1,115 @@
+#include "script.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "command_processor.h"
+#include "jobs.h"
+#include "arena.h"
+#include "line_reader.h"
+
+// --- Private Helper Functions ---
+
+// Returns true if a line has nothing to execute (blank or a '#' comment).
+static bool is_blank_or_comment(const char *line, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (line[i] == ' ' || line[i] == '\t' || line[i] == '\r') continue;
+        return line[i] == '#';
+    }
+    return true;
+}
+
+// A loop spanning several lines is collected here until it is complete.
+static char *g_pending_command = NULL;
+static size_t g_pending_len = 0;
+
+// Runs one NUL-terminated script line unless it is blank or a comment.
+static void run_script_line(const char *line, size_t len, const char *home_dir) {
+    if (is_blank_or_comment(line, len)) {
+        return;
+    }
+    process_job_events(false);
+    if (g_pending_command) {
+        append_command_line(&g_pending_command, &g_pending_len, line);
+        if (process_command_line(g_pending_command, home_dir, false)) {
+            free(g_pending_command);
+            g_pending_command = NULL;
+            g_pending_len = 0;
+        }
+    } else if (!process_command_line(line, home_dir, false)) {
+        append_command_line(&g_pending_command, &g_pending_len, line);
+    }
+    line_arena_finish();
+}
+
+// Rejects a loop left open at the end of the script.
+static void finish_script(void) {
+    if (g_pending_command) {
+        reject_incomplete_command();
+        free(g_pending_command);
+        g_pending_command = NULL;
+        g_pending_len = 0;
+    }
+}
+
+// Feeds each line of an in-memory script to the command processor.
+// Lines are copied into one reusable buffer only to NUL-terminate them.
+static void run_script_buffer(const char *data, size_t size, const char *home_dir) {
+    char *line = NULL;
+    size_t line_capacity = 0;
+    const char *p = data;
+    const char *end = data + size;
+
+    while (p < end) {
+        const char *newline = memchr(p, '\n', end - p);
+        size_t len = newline ? (size_t)(newline - p) : (size_t)(end - p);
+
+        if (len + 1 > line_capacity) {
+            line_capacity = (len + 1) * 2;
+            char *grown = realloc(line, line_capacity);
+            if (!grown) {
+                perror("realloc for script line");
+                break;
+            }
+            line = grown;
+        }
+        memcpy(line, p, len);
+        line[len] = '\0';
+        run_script_line(line, len, home_dir);
+
+        p += len + 1;
+    }
+    free(line);
+}
+
+// --- Public API Implementation ---
+
+int run_script_file(const char *path, const char *home_dir) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC); // Not inherited by the commands it runs
+    if (fd < 0) {
+        perror(path);
+        return 1;
+    }
+
+    // Lines are streamed through a large buffered reader, so scripts of any size
+    // (and pipes) are consumed in big chunks without loading them whole.
+    LineReader reader;
+    line_reader_init(&reader, fd);
+    char *line;
+    size_t len;
+    while ((line = line_reader_next(&reader, &len)) != NULL) {
+        run_script_line(line, len, home_dir);
+    }
+    finish_script();
+    line_reader_free(&reader);
+    close(fd);
+    return get_last_status();
+}
+
+int run_script_string(const char *commands, const char *home_dir) {
+    run_script_buffer(commands, strlen(commands), home_dir);
+    finish_script();
+    return get_last_status();
+}
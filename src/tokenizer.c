@@ -1,55 +1,205 @@
 #include "tokenizer.h"
 #include <stdlib.h>
 #include <string.h>
-#include <ctype.h>
 #include <stdio.h>
+#include "arena.h"
 
-// A helper function to add a token to a dynamic array of tokens.
-static void add_token(Token **tokens, int *count, int *capacity, TokenType type, const char *value) {
-    if (*count >= *capacity) {
-        *capacity = (*capacity == 0) ? 8 : *capacity * 2;
-        *tokens = realloc(*tokens, *capacity * sizeof(Token));
-        if (!*tokens) {
-            perror("realloc");
-            exit(EXIT_FAILURE);
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_DISPATCH 1
+#endif
+
+// The tokenizer makes two passes over the input with the same scanner. The first
+// pass only counts tokens and the bytes needed by name strings; the second pass
+// writes the tokens into one allocation that holds the Token array followed by
+// every name string, each NUL-terminated:
+//
+//   [ Token 0 | Token 1 | ... | EOL ][ "ls\0" "-l\0" "file.txt\0" ... ]
+//
+// so a whole command line costs a single arena allocation.
+
+// --- Delimiter Scanning ---
+// A name token ends at whitespace or at any operator character. The byte classes
+// below replace a per-character isspace() + strchr() call with one table lookup,
+// and the vector scanners test 16 or 32 bytes at a time.
+
+#define CHAR_SPACE    1  // ' ' and '\t' through '\r' (isspace in the C locale)
+#define CHAR_OPERATOR 2  // | & < > ;
+
+static const unsigned char k_char_class[256] = {
+    ['\t'] = CHAR_SPACE, ['\n'] = CHAR_SPACE, ['\v'] = CHAR_SPACE,
+    ['\f'] = CHAR_SPACE, ['\r'] = CHAR_SPACE, [' '] = CHAR_SPACE,
+    ['|'] = CHAR_OPERATOR, ['&'] = CHAR_OPERATOR, ['<'] = CHAR_OPERATOR,
+    ['>'] = CHAR_OPERATOR, [';'] = CHAR_OPERATOR,
+};
+
+// Each scanner returns the first delimiter in [p, end), or 'end' if there is none.
+typedef const char* (*DelimiterScanner)(const char *p, const char *end);
+
+static const char* scan_delimiter_scalar(const char *p, const char *end) {
+    while (p < end && k_char_class[(unsigned char)*p] == 0) {
+        p++;
+    }
+    return p;
+}
+
+#if defined(__SSE2__)
+static const char* scan_delimiter_sse2(const char *p, const char *end) {
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i ws_span = _mm_set1_epi8('\r' - '\t');
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i semi = _mm_set1_epi8(';');
+
+    // Only whole 16-byte blocks inside the string are loaded, so this never
+    // reads past the terminating NUL.
+    while (end - p >= 16) {
+        __m128i c = _mm_loadu_si128((const __m128i *)p);
+        // '\t'..'\r': (c - '\t') <= 4 as an unsigned byte compare.
+        __m128i off = _mm_sub_epi8(c, tab);
+        __m128i hit = _mm_cmpeq_epi8(_mm_min_epu8(off, ws_span), off);
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(c, space));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(c, pipe));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(c, amp));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(c, lt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(c, gt));
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(c, semi));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
         }
+        p += 16;
+    }
+    return scan_delimiter_scalar(p, end);
+}
+#endif
+
+#if defined(HAVE_AVX2_DISPATCH)
+__attribute__((target("avx2")))
+static const char* scan_delimiter_avx2(const char *p, const char *end) {
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i ws_span = _mm256_set1_epi8('\r' - '\t');
+    const __m256i pipe = _mm256_set1_epi8('|');
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i semi = _mm256_set1_epi8(';');
+
+    while (end - p >= 32) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)p);
+        __m256i off = _mm256_sub_epi8(c, tab);
+        __m256i hit = _mm256_cmpeq_epi8(_mm256_min_epu8(off, ws_span), off);
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(c, space));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(c, pipe));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(c, amp));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(c, lt));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(c, gt));
+        hit = _mm256_or_si256(hit, _mm256_cmpeq_epi8(c, semi));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(hit);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return scan_delimiter_scalar(p, end);
+}
+#endif
+
+// The scanner in use; chosen on first use by tokenizer_set_scan_mode(SCAN_AUTO).
+static DelimiterScanner g_scan_delimiter = NULL;
+
+bool tokenizer_set_scan_mode(ScanMode mode) {
+    switch (mode) {
+        case SCAN_AUTO:
+#if defined(HAVE_AVX2_DISPATCH)
+            if (__builtin_cpu_supports("avx2")) {
+                g_scan_delimiter = scan_delimiter_avx2;
+                return true;
+            }
+#endif
+#if defined(__SSE2__)
+            g_scan_delimiter = scan_delimiter_sse2;
+#else
+            g_scan_delimiter = scan_delimiter_scalar;
+#endif
+            return true;
+        case SCAN_SCALAR:
+            g_scan_delimiter = scan_delimiter_scalar;
+            return true;
+        case SCAN_SSE2:
+#if defined(__SSE2__)
+            g_scan_delimiter = scan_delimiter_sse2;
+            return true;
+#else
+            return false;
+#endif
+        case SCAN_AVX2:
+#if defined(HAVE_AVX2_DISPATCH)
+            if (__builtin_cpu_supports("avx2")) {
+                g_scan_delimiter = scan_delimiter_avx2;
+                return true;
+            }
+#endif
+            return false;
     }
+    return false;
+}
 
-    (*tokens)[*count].type = type;
-    // Only TOKEN_NAME has a value that needs to be copied.
-    if (value) {
-        (*tokens)[*count].value = strdup(value);
-        if (!(*tokens)[*count].value) {
-            perror("strdup");
-            exit(EXIT_FAILURE);
+// Appends one token. In the counting pass 'tokens' is NULL and only the
+// counters are advanced.
+static void emit_token(Token *tokens, char **strings, int *count, size_t *string_bytes,
+                       TokenType type, const char *start, size_t len) {
+    if (tokens) {
+        tokens[*count].type = type;
+        tokens[*count].value = NULL;
+        // Only TOKEN_NAME has a value, which is copied into the string area.
+        if (type == TOKEN_NAME) {
+            memcpy(*strings, start, len);
+            (*strings)[len] = '\0';
+            tokens[*count].value = *strings;
+            *strings += len + 1;
         }
-    } else {
-        (*tokens)[*count].value = NULL;
+    }
+    if (type == TOKEN_NAME) {
+        *string_bytes += len + 1;
     }
     (*count)++;
 }
 
-Token* tokenize(const char *input, int *token_count) {
-    Token *tokens = NULL;
-    int count = 0;
-    int capacity = 0;
+// Scans the whole input once. See emit_token for the meaning of 'tokens'.
+static void scan_tokens(const char *input, size_t length, Token *tokens, char *strings, int *count, size_t *string_bytes) {
     const char *p = input;
+    const char *end = input + length;
+    *count = 0;
+    *string_bytes = 0;
 
     while (*p != '\0') {
         // 1. Skip whitespace
-        if (isspace((unsigned char)*p)) {
+        if (k_char_class[(unsigned char)*p] == CHAR_SPACE) {
             p++;
             continue;
         }
 
         // 2. Handle special multi-character tokens
         if (strncmp(p, "&&", 2) == 0) {
-            add_token(&tokens, &count, &capacity, TOKEN_AND_IF, NULL);
+            emit_token(tokens, &strings, count, string_bytes, TOKEN_AND_IF, NULL, 0);
+            p += 2;
+            continue;
+        }
+        if (strncmp(p, "||", 2) == 0) {
+            emit_token(tokens, &strings, count, string_bytes, TOKEN_OR_IF, NULL, 0);
             p += 2;
             continue;
         }
         if (strncmp(p, ">>", 2) == 0) {
-            add_token(&tokens, &count, &capacity, TOKEN_REDIRECT_APPEND, NULL);
+            emit_token(tokens, &strings, count, string_bytes, TOKEN_REDIRECT_APPEND, NULL, 0);
             p += 2;
             continue;
         }
@@ -57,43 +207,33 @@ Token* tokenize(const char *input, int *token_count) {
         // 3. Handle single-character tokens
         switch (*p) {
             case '|':
-                add_token(&tokens, &count, &capacity, TOKEN_PIPE, NULL);
+                emit_token(tokens, &strings, count, string_bytes, TOKEN_PIPE, NULL, 0);
                 p++;
                 continue;
             case '<':
-                add_token(&tokens, &count, &capacity, TOKEN_REDIRECT_IN, NULL);
+                emit_token(tokens, &strings, count, string_bytes, TOKEN_REDIRECT_IN, NULL, 0);
                 p++;
                 continue;
             case '>':
-                add_token(&tokens, &count, &capacity, TOKEN_REDIRECT_OUT, NULL);
+                emit_token(tokens, &strings, count, string_bytes, TOKEN_REDIRECT_OUT, NULL, 0);
                 p++;
                 continue;
             case '&':
-                add_token(&tokens, &count, &capacity, TOKEN_AMPERSAND, NULL);
+                emit_token(tokens, &strings, count, string_bytes, TOKEN_AMPERSAND, NULL, 0);
                 p++;
                 continue;
             case ';':
-                add_token(&tokens, &count, &capacity, TOKEN_SEMICOLON, NULL);
+                emit_token(tokens, &strings, count, string_bytes, TOKEN_SEMICOLON, NULL, 0);
                 p++;
                 continue;
         }
 
         // 4. Handle name tokens (commands, arguments, filenames)
         const char *start = p;
-        while (*p != '\0' && !isspace((unsigned char)*p) && !strchr("|&<>;", *p)) {
-            p++;
-        }
+        p = g_scan_delimiter(p, end);
 
         if (p > start) {
-            char *value = malloc(p - start + 1);
-            if (!value) {
-                perror("malloc");
-                exit(EXIT_FAILURE);
-            }
-            strncpy(value, start, p - start);
-            value[p - start] = '\0';
-            add_token(&tokens, &count, &capacity, TOKEN_NAME, value);
-            free(value);
+            emit_token(tokens, &strings, count, string_bytes, TOKEN_NAME, start, p - start);
         } else {
             // If we are here, it's an invalid character we don't recognize.
             // We could add a TOKEN_INVALID, but for now, we just advance.
@@ -101,17 +241,25 @@ Token* tokenize(const char *input, int *token_count) {
         }
     }
 
-    add_token(&tokens, &count, &capacity, TOKEN_EOL, NULL);
-    *token_count = count;
-    return tokens;
+    emit_token(tokens, &strings, count, string_bytes, TOKEN_EOL, NULL, 0);
 }
 
-void free_tokens(Token *tokens, int token_count) {
-    if (!tokens) return;
-    for (int i = 0; i < token_count; i++) {
-        if (tokens[i].value) {
-            free(tokens[i].value);
-        }
+Token* tokenize(Arena *arena, const char *input, int *token_count) {
+    if (!g_scan_delimiter) {
+        tokenizer_set_scan_mode(SCAN_AUTO);
     }
-    free(tokens);
-}
\ No newline at end of file
+    size_t length = strlen(input);
+
+    // Pass 1: measure.
+    int count;
+    size_t string_bytes;
+    scan_tokens(input, length, NULL, NULL, &count, &string_bytes);
+
+    // Pass 2: fill one block holding the tokens and their strings.
+    Token *tokens = arena_alloc(arena, count * sizeof(Token) + string_bytes);
+    char *strings = (char *)(tokens + count);
+    scan_tokens(input, length, tokens, strings, &count, &string_bytes);
+
+    *token_count = count;
+    return tokens;
+}
@@ -0,0 +1,136 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+// Spans are written out once this much JSON has been buffered.
+#define TRACE_BUFFER_SIZE 65536
+// Longest event; a longer detail is cut short.
+#define TRACE_MAX_EVENT 1024
+
+bool g_tracing = false;
+
+static int g_trace_fd = -1;
+static char g_trace_buffer[TRACE_BUFFER_SIZE];
+static size_t g_trace_used = 0;
+static bool g_first_event = true;
+// Forked children inherit the buffer; only the shell that opened the file writes it.
+static pid_t g_trace_owner = 0;
+
+// --- Private Helper Functions ---
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+static void write_all(const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(g_trace_fd, data, len);
+        if (n < 0) {
+            perror("trace");
+            g_tracing = false; // Stop rather than fail on every span.
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+// Appends 'text' to 'out' as the body of a JSON string. Returns the new length,
+// never more than 'size' - 1.
+static size_t append_json_string(char *out, size_t len, size_t size, const char *text) {
+    for (const unsigned char *p = (const unsigned char *)text; *p && len + 7 < size; p++) {
+        if (*p == '"' || *p == '\\') {
+            out[len++] = '\\';
+            out[len++] = *p;
+        } else if (*p < 0x20) {
+            len += snprintf(out + len, size - len, "\\u%04x", *p);
+        } else {
+            out[len++] = *p;
+        }
+    }
+    return len;
+}
+
+// --- Public API Implementation ---
+
+void init_trace(void) {
+    const char *path = getenv("MINI_SHELL_TRACE");
+    if (!path || path[0] == '\0') {
+        return;
+    }
+    g_trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (g_trace_fd < 0) {
+        perror(path);
+        return;
+    }
+    g_trace_owner = getpid();
+    g_tracing = true;
+    memcpy(g_trace_buffer, "[\n", 2);
+    g_trace_used = 2;
+}
+
+uint64_t trace_begin(void) {
+    return g_tracing ? now_ns() : 0;
+}
+
+void trace_end(const char *name, uint64_t start, const char *detail) {
+    if (start == 0 || !g_tracing) {
+        return;
+    }
+    uint64_t end = now_ns();
+    char event[TRACE_MAX_EVENT];
+    // Timestamps and durations are in microseconds.
+    size_t len = snprintf(event, sizeof(event),
+                          "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                          g_first_event ? "" : ",\n", name, (int)g_trace_owner, (int)g_trace_owner,
+                          start / 1000.0, (end - start) / 1000.0);
+    if (detail && len < sizeof(event)) {
+        len += snprintf(event + len, sizeof(event) - len, ",\"args\":{\"detail\":\"");
+        len = append_json_string(event, len, sizeof(event) - 4, detail);
+        len += snprintf(event + len, sizeof(event) - len, "\"}");
+    }
+    if (len + 1 >= sizeof(event)) {
+        return; // Cannot happen with the names used, but never emit broken JSON.
+    }
+    event[len++] = '}';
+    g_first_event = false;
+
+    if (g_trace_used + len > sizeof(g_trace_buffer)) {
+        trace_flush();
+        if (g_trace_used + len > sizeof(g_trace_buffer)) {
+            return; // A forked child, which never writes the trace.
+        }
+    }
+    memcpy(g_trace_buffer + g_trace_used, event, len);
+    g_trace_used += len;
+}
+
+void trace_flush(void) {
+    if (g_trace_fd < 0 || g_trace_used == 0 || getpid() != g_trace_owner) {
+        return;
+    }
+    write_all(g_trace_buffer, g_trace_used);
+    g_trace_used = 0;
+}
+
+void cleanup_trace(void) {
+    if (g_trace_fd < 0 || getpid() != g_trace_owner) {
+        return;
+    }
+    const char *close_array = "\n]\n";
+    if (g_trace_used + strlen(close_array) > sizeof(g_trace_buffer)) {
+        trace_flush();
+    }
+    memcpy(g_trace_buffer + g_trace_used, close_array, strlen(close_array));
+    g_trace_used += strlen(close_array);
+    trace_flush();
+    close(g_trace_fd);
+    g_trace_fd = -1;
+    g_tracing = false;
+}
@@ -0,0 +1,190 @@
+#define _DEFAULT_SOURCE // For wait4()
+#include "usage.h"
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "variables.h"
+#include "trace.h"
+
+// Most processes whose usage one 'time' report lists; later stages are only counted
+// in the total.
+#define MAX_TIMED_STAGES 32
+
+// Totals over every foreground child reaped so far. Timers take the difference
+// between their start and stop, so they nest without any bookkeeping per child.
+static ResourceUsage g_foreground_total = {0};
+static int g_foreground_reaped = 0;
+// Largest child seen since the innermost running timer started.
+static long g_peak_rss_kb = 0;
+
+// Per-process records for 'time' reports, kept while any timer runs.
+typedef struct {
+    char name[64];
+    ResourceUsage usage;
+} StageUsage;
+
+static StageUsage g_stages[MAX_TIMED_STAGES];
+static int g_num_stages = 0;
+static int g_running_timers = 0;
+
+static long g_history_entry = -1;
+
+// --- Private Helper Functions ---
+
+static double timeval_seconds(struct timeval tv) {
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void usage_from_rusage(const struct rusage *ru, ResourceUsage *usage) {
+    usage->real_seconds = 0;
+    usage->user_seconds = timeval_seconds(ru->ru_utime);
+    usage->system_seconds = timeval_seconds(ru->ru_stime);
+    usage->max_rss_kb = ru->ru_maxrss; // Kilobytes on Linux
+    usage->voluntary_switches = ru->ru_nvcsw;
+    usage->involuntary_switches = ru->ru_nivcsw;
+}
+
+static void shell_usage(ResourceUsage *usage) {
+    struct rusage ru;
+    if (getrusage(RUSAGE_SELF, &ru) != 0) {
+        memset(&ru, 0, sizeof(ru));
+    }
+    usage_from_rusage(&ru, usage);
+}
+
+// Sets 'delta' to what was used between the totals 'before' and 'after'.
+static void subtract_usage(const ResourceUsage *after, const ResourceUsage *before, ResourceUsage *delta) {
+    delta->user_seconds = after->user_seconds - before->user_seconds;
+    delta->system_seconds = after->system_seconds - before->system_seconds;
+    delta->voluntary_switches = after->voluntary_switches - before->voluntary_switches;
+    delta->involuntary_switches = after->involuntary_switches - before->involuntary_switches;
+}
+
+// --- Public API Implementation ---
+
+pid_t wait_with_usage(pid_t pid, int *status, int options, ResourceUsage *usage) {
+    struct rusage ru;
+    pid_t reaped = wait4(pid, status, options, &ru);
+    if (reaped > 0 && (WIFEXITED(*status) || WIFSIGNALED(*status))) {
+        usage_from_rusage(&ru, usage);
+    } else {
+        memset(usage, 0, sizeof(*usage));
+    }
+    return reaped;
+}
+
+pid_t wait_for_foreground(pid_t pid, int *status, int options, const char *name) {
+    ResourceUsage usage;
+    uint64_t span = trace_begin();
+    pid_t reaped = wait_with_usage(pid, status, options, &usage);
+    if (reaped > 0) {
+        trace_end("wait", span, name);
+    }
+    if (reaped <= 0 || !(WIFEXITED(*status) || WIFSIGNALED(*status))) {
+        return reaped; // Still running, or stopped: nothing to count yet.
+    }
+    add_usage(&g_foreground_total, &usage);
+    g_foreground_reaped++;
+    if (usage.max_rss_kb > g_peak_rss_kb) {
+        g_peak_rss_kb = usage.max_rss_kb;
+    }
+    if (g_running_timers > 0 && g_num_stages < MAX_TIMED_STAGES) {
+        StageUsage *stage = &g_stages[g_num_stages++];
+        snprintf(stage->name, sizeof(stage->name), "%s", name ? name : "?");
+        stage->usage = usage;
+    }
+    return reaped;
+}
+
+void usage_timer_start(UsageTimer *timer) {
+    clock_gettime(CLOCK_MONOTONIC, &timer->started);
+    shell_usage(&timer->shell);
+    timer->children = g_foreground_total;
+    timer->children_reaped = g_foreground_reaped;
+    timer->saved_peak_rss = g_peak_rss_kb;
+    timer->first_stage = g_num_stages;
+    g_peak_rss_kb = 0;
+    g_running_timers++;
+}
+
+void usage_timer_stop(UsageTimer *timer, ResourceUsage *usage) {
+    ResourceUsage shell_now, shell_delta, children_delta;
+    shell_usage(&shell_now);
+    subtract_usage(&shell_now, &timer->shell, &shell_delta);
+    subtract_usage(&g_foreground_total, &timer->children, &children_delta);
+
+    usage->real_seconds = seconds_since(&timer->started);
+    usage->user_seconds = shell_delta.user_seconds + children_delta.user_seconds;
+    usage->system_seconds = shell_delta.system_seconds + children_delta.system_seconds;
+    usage->voluntary_switches = shell_delta.voluntary_switches + children_delta.voluntary_switches;
+    usage->involuntary_switches = shell_delta.involuntary_switches + children_delta.involuntary_switches;
+    // Without children the work was done by a built-in, in the shell itself.
+    usage->max_rss_kb = (g_foreground_reaped > timer->children_reaped) ? g_peak_rss_kb : shell_now.max_rss_kb;
+
+    // The enclosing timer also saw everything this one did.
+    if (timer->saved_peak_rss > g_peak_rss_kb) {
+        g_peak_rss_kb = timer->saved_peak_rss;
+    }
+    g_running_timers--;
+    if (g_running_timers == 0) {
+        g_num_stages = 0;
+    }
+}
+
+void report_usage(UsageTimer *timer) {
+    // The stage records stay in place after the timer stops, until the next reap.
+    int first_stage = timer->first_stage;
+    int last_stage = g_num_stages;
+    ResourceUsage usage;
+    usage_timer_stop(timer, &usage);
+
+    char text[256];
+    format_usage(&usage, text, sizeof(text));
+    fflush(stdout); // Keep the report after the command's own output.
+    fprintf(stderr, "%s\n", text);
+    if (last_stage - first_stage > 1) {
+        for (int i = first_stage; i < last_stage; i++) {
+            format_usage(&g_stages[i].usage, text, sizeof(text));
+            // A process's own wall-clock time is unknown, so "real" is left out.
+            fprintf(stderr, "  %-12s %s\n", g_stages[i].name, strstr(text, "user"));
+        }
+    }
+    if (g_running_timers > 0) {
+        g_num_stages = first_stage; // Reported already; an enclosing 'time' lists only its own.
+    }
+}
+
+void add_usage(ResourceUsage *total, const ResourceUsage *part) {
+    if (part->real_seconds > total->real_seconds) total->real_seconds = part->real_seconds;
+    total->user_seconds += part->user_seconds;
+    total->system_seconds += part->system_seconds;
+    if (part->max_rss_kb > total->max_rss_kb) total->max_rss_kb = part->max_rss_kb;
+    total->voluntary_switches += part->voluntary_switches;
+    total->involuntary_switches += part->involuntary_switches;
+}
+
+void format_usage(const ResourceUsage *usage, char *out, size_t size) {
+    snprintf(out, size, "real %.3fs user %.3fs sys %.3fs maxrss %ldKB csw %ld/%ld",
+             usage->real_seconds, usage->user_seconds, usage->system_seconds,
+             usage->max_rss_kb, usage->voluntary_switches, usage->involuntary_switches);
+}
+
+double seconds_since(const struct timespec *start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+bool usage_tracking_enabled(void) {
+    const char *value = get_variable("MINI_SHELL_TIMING", 17);
+    return value && value[0] != '\0' && strcmp(value, "0") != 0;
+}
+
+long get_usage_history_entry(void) {
+    return g_history_entry;
+}
+
+void set_usage_history_entry(long entry_id) {
+    g_history_entry = entry_id;
+}
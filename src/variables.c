@@ -0,0 +1,321 @@
+#include "variables.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+extern char **environ;
+
+// --- Hash Table Data Structures ---
+
+typedef struct Variable {
+    char *entry;            // "NAME=value", the exact string handed to child processes
+    size_t name_len;        // Length of the NAME part of 'entry'
+    bool is_set;            // False for a name that was exported before it had a value
+    bool exported;
+    int env_index;          // Position in g_envp, or -1 if not in the environment
+    unsigned int hash;
+    struct Variable *next;  // Next variable in the same bucket
+} Variable;
+
+// The bucket count is a power of two and doubles once the table is full,
+// so lookups stay O(1) however many variables a script sets.
+#define VARIABLE_MIN_BUCKETS 64
+
+static Variable **g_buckets = NULL;
+static unsigned int g_bucket_count = 0;
+static unsigned int g_variable_count = 0;
+
+// The environment for child processes: the entries of every exported variable
+// that has a value, NULL-terminated. It is updated in place as variables change,
+// so launching a program never has to rebuild it. g_env_owners[i] is the
+// variable whose entry is g_envp[i].
+static char **g_envp = NULL;
+static Variable **g_env_owners = NULL;
+static int g_env_count = 0;
+static int g_env_capacity = 0;
+// The process environment the shell started with, restored on cleanup.
+static char **g_initial_environ = NULL;
+
+// --- Private Helper Functions ---
+
+// djb2 hash over the first 'len' bytes of 'name'.
+static unsigned int hash_name(const char *name, size_t len) {
+    unsigned int hash = 5381;
+    for (size_t i = 0; i < len; i++) {
+        hash = hash * 33 + (unsigned char)name[i];
+    }
+    return hash;
+}
+
+static Variable* find_variable(const char *name, size_t len, unsigned int hash) {
+    if (!g_buckets) {
+        return NULL;
+    }
+    for (Variable *var = g_buckets[hash & (g_bucket_count - 1)]; var; var = var->next) {
+        if (var->hash == hash && var->name_len == len && memcmp(var->entry, name, len) == 0) {
+            return var;
+        }
+    }
+    return NULL;
+}
+
+// Makes room for one more variable, rehashing into twice as many buckets when full.
+static void reserve_variable(void) {
+    if (g_variable_count < g_bucket_count) {
+        return;
+    }
+    unsigned int new_count = g_bucket_count ? g_bucket_count * 2 : VARIABLE_MIN_BUCKETS;
+    Variable **new_buckets = calloc(new_count, sizeof(Variable *));
+    if (!new_buckets) {
+        perror("calloc for variables");
+        exit(EXIT_FAILURE);
+    }
+    for (unsigned int i = 0; i < g_bucket_count; i++) {
+        Variable *var = g_buckets[i];
+        while (var) {
+            Variable *next = var->next;
+            var->next = new_buckets[var->hash & (new_count - 1)];
+            new_buckets[var->hash & (new_count - 1)] = var;
+            var = next;
+        }
+    }
+    free(g_buckets);
+    g_buckets = new_buckets;
+    g_bucket_count = new_count;
+}
+
+// Builds a "NAME=value" string.
+static char* make_entry(const char *name, size_t name_len, const char *value) {
+    size_t value_len = strlen(value);
+    char *entry = malloc(name_len + value_len + 2);
+    if (!entry) {
+        perror("malloc for variable");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(entry, name, name_len);
+    entry[name_len] = '=';
+    memcpy(entry + name_len + 1, value, value_len + 1);
+    return entry;
+}
+
+// Looks a variable up, creating it (unset and not exported) if it does not exist.
+static Variable* find_or_create_variable(const char *name, size_t len) {
+    unsigned int hash = hash_name(name, len);
+    Variable *var = find_variable(name, len, hash);
+    if (var) {
+        return var;
+    }
+    reserve_variable();
+    var = malloc(sizeof(Variable));
+    if (!var) {
+        perror("malloc for variable");
+        exit(EXIT_FAILURE);
+    }
+    var->entry = make_entry(name, len, "");
+    var->name_len = len;
+    var->is_set = false;
+    var->exported = false;
+    var->env_index = -1;
+    var->hash = hash;
+    var->next = g_buckets[hash & (g_bucket_count - 1)];
+    g_buckets[hash & (g_bucket_count - 1)] = var;
+    g_variable_count++;
+    return var;
+}
+
+// Brings the variable's slot in the environment up to date: O(1) in every case.
+// The shell's own environ points at the same array, so getenv() agrees with it.
+static void sync_environment(Variable *var) {
+    bool belongs = var->exported && var->is_set;
+    if (belongs && var->env_index >= 0) {
+        g_envp[var->env_index] = var->entry;
+    } else if (belongs) {
+        if (g_env_count + 1 >= g_env_capacity) {
+            int new_capacity = g_env_capacity ? g_env_capacity * 2 : 64;
+            char **new_envp = realloc(g_envp, new_capacity * sizeof(char *));
+            if (!new_envp) {
+                perror("realloc for environment");
+                exit(EXIT_FAILURE);
+            }
+            g_envp = new_envp;
+            Variable **new_owners = realloc(g_env_owners, new_capacity * sizeof(Variable *));
+            if (!new_owners) {
+                perror("realloc for environment");
+                exit(EXIT_FAILURE);
+            }
+            g_env_owners = new_owners;
+            g_env_capacity = new_capacity;
+        }
+        var->env_index = g_env_count;
+        g_envp[g_env_count] = var->entry;
+        g_env_owners[g_env_count] = var;
+        g_env_count++;
+        g_envp[g_env_count] = NULL;
+    } else if (var->env_index >= 0) {
+        // Move the last entry into the hole.
+        int last = g_env_count - 1;
+        g_envp[var->env_index] = g_envp[last];
+        g_env_owners[var->env_index] = g_env_owners[last];
+        g_env_owners[var->env_index]->env_index = var->env_index;
+        g_envp[last] = NULL;
+        g_env_count--;
+        var->env_index = -1;
+    }
+    if (g_envp) {
+        environ = g_envp;
+    }
+}
+
+static int compare_entries(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// --- Public API Implementation ---
+
+void init_variables(void) {
+    g_initial_environ = environ;
+    for (char **env = environ; env && *env; env++) {
+        const char *equals = strchr(*env, '=');
+        if (!equals) {
+            continue;
+        }
+        // A name that is not an identifier (e.g. "my-var") is kept for child
+        // processes, though "$my-var" can never refer to it.
+        size_t name_len = equals - *env;
+        Variable *var = find_or_create_variable(*env, name_len);
+        var->exported = true;
+        set_variable_n(*env, name_len, equals + 1);
+    }
+}
+
+void set_variable_n(const char *name, size_t name_len, const char *value) {
+    Variable *var = find_or_create_variable(name, name_len);
+    char *old_entry = var->entry;
+    var->entry = make_entry(name, name_len, value);
+    var->is_set = true;
+    sync_environment(var);
+    free(old_entry);
+}
+
+void set_variable(const char *name, const char *value) {
+    set_variable_n(name, strlen(name), value);
+}
+
+const char* get_variable(const char *name, size_t name_len) {
+    Variable *var = find_variable(name, name_len, hash_name(name, name_len));
+    if (var && var->is_set) {
+        return var->entry + var->name_len + 1;
+    }
+    return NULL;
+}
+
+void export_variable(const char *name) {
+    Variable *var = find_or_create_variable(name, strlen(name));
+    var->exported = true;
+    sync_environment(var);
+}
+
+void unset_variable(const char *name) {
+    size_t len = strlen(name);
+    unsigned int hash = hash_name(name, len);
+    Variable *var = find_variable(name, len, hash);
+    if (!var) {
+        return;
+    }
+    var->exported = false;
+    var->is_set = false;
+    sync_environment(var);
+
+    Variable **link = &g_buckets[hash & (g_bucket_count - 1)];
+    while (*link != var) {
+        link = &(*link)->next;
+    }
+    *link = var->next;
+    g_variable_count--;
+    free(var->entry);
+    free(var);
+}
+
+char** variables_environment(void) {
+    static char *empty[] = {NULL};
+    return g_envp ? g_envp : empty;
+}
+
+char** variables_environment_with(char *const *assignments, int count, Arena *arena) {
+    char **envp = arena_alloc(arena, (g_env_count + count + 1) * sizeof(char *));
+    memcpy(envp, variables_environment(), (g_env_count + 1) * sizeof(char *));
+    int env_count = g_env_count;
+    for (int i = 0; i < count; i++) {
+        size_t name_len = strcspn(assignments[i], "=") + 1; // Including the '='
+        int j = 0;
+        while (j < env_count && strncmp(envp[j], assignments[i], name_len) != 0) {
+            j++;
+        }
+        if (j == env_count) {
+            envp[env_count++] = NULL;
+            envp[env_count] = NULL;
+        }
+        envp[j] = assignments[i];
+    }
+    return envp;
+}
+
+void print_exported_variables(void) {
+    // Sorted by name, as other shells list them.
+    char **sorted = malloc((g_env_count + 1) * sizeof(char *));
+    if (!sorted) {
+        perror("malloc for export");
+        return;
+    }
+    memcpy(sorted, variables_environment(), (g_env_count + 1) * sizeof(char *));
+    qsort(sorted, g_env_count, sizeof(char *), compare_entries);
+    for (int i = 0; i < g_env_count; i++) {
+        printf("export %s\n", sorted[i]);
+    }
+    free(sorted);
+}
+
+size_t variable_name_length(const char *str) {
+    if (!isalpha((unsigned char)str[0]) && str[0] != '_') {
+        return 0;
+    }
+    size_t len = 1;
+    while (isalnum((unsigned char)str[len]) || str[len] == '_') {
+        len++;
+    }
+    return len;
+}
+
+bool is_valid_variable_name(const char *name) {
+    size_t len = variable_name_length(name);
+    return len > 0 && name[len] == '\0';
+}
+
+bool is_assignment(const char *word) {
+    size_t len = variable_name_length(word);
+    return len > 0 && word[len] == '=';
+}
+
+void cleanup_variables(void) {
+    environ = g_initial_environ;
+    for (unsigned int i = 0; i < g_bucket_count; i++) {
+        Variable *var = g_buckets[i];
+        while (var) {
+            Variable *next = var->next;
+            free(var->entry);
+            free(var);
+            var = next;
+        }
+    }
+    free(g_buckets);
+    g_buckets = NULL;
+    g_bucket_count = 0;
+    g_variable_count = 0;
+    free(g_envp);
+    free(g_env_owners);
+    g_envp = NULL;
+    g_env_owners = NULL;
+    g_env_count = 0;
+    g_env_capacity = 0;
+}
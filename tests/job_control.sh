@@ -0,0 +1,49 @@
+#!/bin/sh
+# 'fg' and 'bg' in script mode, where jobs stay in the shell's process group and
+# are continued by pid rather than by group.
+# Usage: tests/job_control.sh [path/to/shell.out]   (default: ./shell.out)
+
+SHELL_OUT=$(realpath "${1:-./shell.out}")
+DIR=$(mktemp -d)
+trap 'pkill -KILL -f "$DIR/stop_self" 2>/dev/null; rm -rf "$DIR"' EXIT
+cd "$DIR" || exit 1
+failed=0
+
+# Runs the shell with the given arguments and prints what it wrote. The output
+# goes through a file, so a job left stopped cannot keep a pipe open, and a
+# shell stuck waiting for such a job is killed.
+run_shell() {
+    timeout 10 "$SHELL_OUT" "$@" > output.txt 2>&1
+    cat output.txt
+}
+
+check() {
+    if ! printf '%s\n' "$2" | grep -q "$3"; then
+        echo "FAIL: $1: expected '$3' in:"
+        printf '%s\n' "$2"
+        failed=1
+    fi
+}
+
+# A job that stops itself, as Ctrl-Z would stop it. It is run by its full path,
+# so any left stopped can be found and killed on exit.
+printf '#!/bin/sh\nkill -STOP $$\necho resumed\n' > stop_self
+chmod +x stop_self
+
+output=$(run_shell -c "$(printf 'sleep 0.2 &\nfg\necho status=$?')")
+check "fg on a running job" "$output" "status=0"
+
+printf '%s/stop_self &\nsleep 0.2\nfg\necho status=$?\n' "$DIR" > fg_stopped.sh
+output=$(run_shell fg_stopped.sh)
+check "fg on a stopped job" "$output" "resumed"
+check "fg on a stopped job" "$output" "status=0"
+
+printf '%s/stop_self &\nsleep 0.2\nbg\nsleep 0.3\n' "$DIR" > bg_stopped.sh
+output=$(run_shell bg_stopped.sh)
+check "bg on a stopped job" "$output" "\\[1\\] .*/stop_self &"
+check "bg on a stopped job" "$output" "resumed"
+
+if [ "$failed" -eq 0 ]; then
+    echo "job_control: ok"
+fi
+exit "$failed"